@@ -0,0 +1,31 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+
+// Blocks threads calling Wait until all of the given number of threads
+// have called it, then lets them all go and can be passed again
+class Barrier {
+ public:
+  explicit Barrier(size_t thread_count) : thread_count_(thread_count) {}
+
+  void Wait() {
+    std::unique_lock lock(mutex_);
+    const size_t phase = phase_;
+    if (++waiting_count_ == thread_count_) {
+      waiting_count_ = 0;
+      ++phase_;
+      all_arrived_.notify_all();
+    } else {
+      all_arrived_.wait(lock, [this, phase] { return phase_ != phase; });
+    }
+  }
+
+ private:
+  const size_t thread_count_;
+  size_t waiting_count_ = 0;
+  size_t phase_ = 0;
+  std::mutex mutex_;
+  std::condition_variable all_arrived_;
+};
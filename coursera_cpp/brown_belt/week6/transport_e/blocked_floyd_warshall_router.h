@@ -0,0 +1,395 @@
+#pragma once
+
+#include "barrier.h"
+#include "graph.h"
+#include "irouter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Builds an AVX2 version of the min-plus kernel next to the default one and
+// picks it at load time where the CPU supports it
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MIN_PLUS_KERNEL_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define MIN_PLUS_KERNEL_CLONES
+#endif
+
+namespace Graph {
+
+// The same all-pairs precompute as Router, but weights and last edges of
+// routes live in two flat row-major matrices with infinity instead of
+// missing routes. Floyd-Warshall runs over square tiles: for every tile of
+// intermediate vertices the diagonal tile goes first, then its row and
+// column, then all the other tiles, which are independent of each other
+// and are spread over threads. The threads are started once per build and
+// wait for each other between the steps.
+template <typename Weight>
+class BlockedFloydWarshallRouter : public IRouter<Weight> {
+  static_assert(std::numeric_limits<Weight>::has_infinity,
+                "weight must have an infinity sentinel");
+
+ private:
+  using Graph = DirectedWeightedGraph<Weight>;
+
+ public:
+  // Builds and later adds edges on thread_count threads, the calling one
+  // included
+  explicit BlockedFloydWarshallRouter(const Graph& graph,
+                                      size_t thread_count = 1);
+  // Uses matrices of a snapshot in place, so the reader's data must
+  // outlive the router
+  BlockedFloydWarshallRouter(const Graph& graph,
+                             Serialization::Reader& reader,
+                             size_t thread_count = 1);
+
+  using typename IRouter<Weight>::RouteInfo;
+
+  std::optional<Weight> WriteRoute(VertexId from,
+                                   VertexId to,
+                                   std::vector<EdgeId>& edges) const override;
+
+  std::vector<std::optional<Weight>> ComputeRouteWeights(
+      VertexId from,
+      const std::vector<VertexId>& targets) const override;
+
+  void Serialize(Serialization::Writer& writer) const override;
+
+  // Matrices mapped from a snapshot count as well
+  size_t ComputeMemoryUsage() const override {
+    return stride_ * stride_ * (sizeof(Weight) + sizeof(EdgeId));
+  }
+
+  // Relaxes all routes through each new edge with the same row kernel.
+  // Matrices of a snapshot are copied first, and widened if the graph has
+  // outgrown them.
+  bool AddEdges(EdgeId first_new_edge) override;
+
+ private:
+  static constexpr size_t BLOCK_SIZE = 64;
+  static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+  static constexpr Weight INFINITE_WEIGHT =
+      std::numeric_limits<Weight>::infinity();
+
+  void InitializeMatrices();
+
+  // Makes owned matrices at least as wide as the graph
+  void ResizeMatrices();
+
+  void RelaxBlock(size_t row_block, size_t column_block, size_t through_block);
+
+  MIN_PLUS_KERNEL_CLONES
+  static void RelaxRow(Weight weight_to_through,
+                       const Weight* through_weights,
+                       const EdgeId* through_prev_edges,
+                       Weight* row_weights,
+                       EdgeId* row_prev_edges);
+
+  // Runs work(thread_idx, barrier) on thread_count_ threads, the calling one
+  // among them, which share the barrier to go through steps together
+  template <typename Work>
+  void RunOnThreads(Work work) const;
+
+  // Runs relax_block_row(block_row) for the rows in [0, block_count) which
+  // fall to the thread, except the skipped one
+  template <typename RelaxBlockRow>
+  void ForEachBlockRow(size_t thread_idx,
+                       size_t skipped_block_row,
+                       RelaxBlockRow relax_block_row) const;
+
+  size_t GetCellIndex(VertexId from, VertexId to) const {
+    return from * stride_ + to;
+  }
+
+  const Graph& graph_;
+  size_t thread_count_;
+  size_t block_count_;
+  size_t stride_;  // vertex count rounded up to a multiple of BLOCK_SIZE
+  std::vector<Weight> weights_;
+  std::vector<EdgeId> prev_edges_;
+  // Point either to the matrices above or into a loaded snapshot
+  const Weight* route_weights_;
+  const EdgeId* route_prev_edges_;
+};
+
+template <typename Weight>
+BlockedFloydWarshallRouter<Weight>::BlockedFloydWarshallRouter(
+    const Graph& graph,
+    size_t thread_count)
+    : graph_(graph),
+      thread_count_(std::max<size_t>(thread_count, 1)),
+      block_count_((graph.GetVertexCount() + BLOCK_SIZE - 1) / BLOCK_SIZE),
+      stride_(block_count_ * BLOCK_SIZE),
+      weights_(stride_ * stride_, INFINITE_WEIGHT),
+      prev_edges_(stride_ * stride_, NO_EDGE),
+      route_weights_(weights_.data()),
+      route_prev_edges_(prev_edges_.data()) {
+  InitializeMatrices();
+
+  RunOnThreads([this](size_t thread_idx, Barrier& barrier) {
+    for (size_t through_block = 0; through_block < block_count_;
+         ++through_block) {
+      if (thread_idx == 0) {
+        RelaxBlock(through_block, through_block, through_block);
+      }
+      barrier.Wait();
+      ForEachBlockRow(thread_idx, through_block, [&](size_t block) {
+        RelaxBlock(through_block, block, through_block);
+        RelaxBlock(block, through_block, through_block);
+      });
+      barrier.Wait();
+      ForEachBlockRow(thread_idx, through_block, [&](size_t row_block) {
+        for (size_t column_block = 0; column_block < block_count_;
+             ++column_block) {
+          if (column_block != through_block) {
+            RelaxBlock(row_block, column_block, through_block);
+          }
+        }
+      });
+      barrier.Wait();
+    }
+  });
+}
+
+template <typename Weight>
+BlockedFloydWarshallRouter<Weight>::BlockedFloydWarshallRouter(
+    const Graph& graph,
+    Serialization::Reader& reader,
+    size_t thread_count)
+    : graph_(graph),
+      thread_count_(std::max<size_t>(thread_count, 1)),
+      block_count_(0) {
+  stride_ = reader.Read<uint64_t>();
+  const auto weights = reader.ReadArray<Weight>();
+  const auto prev_edges = reader.ReadArray<EdgeId>();
+  if (stride_ < graph.GetVertexCount() ||
+      static_cast<size_t>(weights.end() - weights.begin()) !=
+          stride_ * stride_ ||
+      static_cast<size_t>(prev_edges.end() - prev_edges.begin()) !=
+          stride_ * stride_) {
+    throw std::runtime_error("routes matrices don't match the graph");
+  }
+  route_weights_ = weights.begin();
+  route_prev_edges_ = prev_edges.begin();
+}
+
+template <typename Weight>
+void BlockedFloydWarshallRouter<Weight>::InitializeMatrices() {
+  for (VertexId vertex = 0; vertex < stride_; ++vertex) {
+    weights_[GetCellIndex(vertex, vertex)] = 0;
+  }
+  for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    const auto& edge = graph_.GetEdge(edge_id);
+    assert(edge.weight >= 0);
+    const size_t cell_idx = GetCellIndex(edge.from, edge.to);
+    if (edge.weight < weights_[cell_idx]) {
+      weights_[cell_idx] = edge.weight;
+      prev_edges_[cell_idx] = edge_id;
+    }
+  }
+}
+
+template <typename Weight>
+void BlockedFloydWarshallRouter<Weight>::ResizeMatrices() {
+  const size_t stride = std::max(
+      stride_,
+      (graph_.GetVertexCount() + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE);
+  if (stride == stride_ && route_weights_ == weights_.data()) {
+    return;
+  }
+
+  std::vector<Weight> weights(stride * stride, INFINITE_WEIGHT);
+  std::vector<EdgeId> prev_edges(stride * stride, NO_EDGE);
+  for (VertexId from = 0; from < stride_; ++from) {
+    std::copy_n(route_weights_ + from * stride_, stride_,
+                weights.begin() + from * stride);
+    std::copy_n(route_prev_edges_ + from * stride_, stride_,
+                prev_edges.begin() + from * stride);
+  }
+  for (VertexId vertex = stride_; vertex < stride; ++vertex) {
+    weights[vertex * stride + vertex] = 0;
+  }
+
+  stride_ = stride;
+  block_count_ = stride / BLOCK_SIZE;
+  weights_ = std::move(weights);
+  prev_edges_ = std::move(prev_edges);
+  route_weights_ = weights_.data();
+  route_prev_edges_ = prev_edges_.data();
+}
+
+template <typename Weight>
+bool BlockedFloydWarshallRouter<Weight>::AddEdges(EdgeId first_new_edge) {
+  ResizeMatrices();
+
+  // Routes from the end of the edge, where the empty route to the end
+  // itself gets the edge as its last one
+  std::vector<Weight> through_weights(stride_);
+  std::vector<EdgeId> through_prev_edges(stride_);
+  RunOnThreads([&](size_t thread_idx, Barrier& barrier) {
+    for (EdgeId edge_id = first_new_edge; edge_id < graph_.GetEdgeCount();
+         ++edge_id) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      if (thread_idx == 0) {
+        assert(edge.weight >= 0);
+        const size_t through_row_idx = GetCellIndex(edge.to, 0);
+        std::copy_n(&weights_[through_row_idx], stride_,
+                    through_weights.begin());
+        std::copy_n(&prev_edges_[through_row_idx], stride_,
+                    through_prev_edges.begin());
+        through_prev_edges[edge.to] = edge_id;
+      }
+      barrier.Wait();
+      ForEachBlockRow(thread_idx, block_count_, [&](size_t block_row) {
+        for (VertexId vertex_from = block_row * BLOCK_SIZE;
+             vertex_from < (block_row + 1) * BLOCK_SIZE; ++vertex_from) {
+          const Weight weight_to_start =
+              weights_[GetCellIndex(vertex_from, edge.from)];
+          if (weight_to_start == INFINITE_WEIGHT) {
+            continue;
+          }
+          for (size_t column_begin = 0; column_begin < stride_;
+               column_begin += BLOCK_SIZE) {
+            const size_t row_idx = GetCellIndex(vertex_from, column_begin);
+            RelaxRow(weight_to_start + edge.weight,
+                     &through_weights[column_begin],
+                     &through_prev_edges[column_begin], &weights_[row_idx],
+                     &prev_edges_[row_idx]);
+          }
+        }
+      });
+      barrier.Wait();
+    }
+  });
+  return true;
+}
+
+template <typename Weight>
+void BlockedFloydWarshallRouter<Weight>::RelaxBlock(size_t row_block,
+                                                    size_t column_block,
+                                                    size_t through_block) {
+  const size_t row_begin = row_block * BLOCK_SIZE;
+  const size_t column_begin = column_block * BLOCK_SIZE;
+  const size_t through_begin = through_block * BLOCK_SIZE;
+  for (VertexId vertex_through = through_begin;
+       vertex_through < through_begin + BLOCK_SIZE; ++vertex_through) {
+    const size_t through_row_idx = GetCellIndex(vertex_through, column_begin);
+    const Weight* through_weights = &weights_[through_row_idx];
+    const EdgeId* through_prev_edges = &prev_edges_[through_row_idx];
+    for (VertexId vertex_from = row_begin; vertex_from < row_begin + BLOCK_SIZE;
+         ++vertex_from) {
+      const Weight weight_to_through =
+          weights_[GetCellIndex(vertex_from, vertex_through)];
+      if (weight_to_through == INFINITE_WEIGHT) {
+        continue;
+      }
+      const size_t row_idx = GetCellIndex(vertex_from, column_begin);
+      RelaxRow(weight_to_through, through_weights, through_prev_edges,
+               &weights_[row_idx], &prev_edges_[row_idx]);
+    }
+  }
+}
+
+template <typename Weight>
+void BlockedFloydWarshallRouter<Weight>::RelaxRow(
+    Weight weight_to_through,
+    const Weight* through_weights,
+    const EdgeId* through_prev_edges,
+    Weight* row_weights,
+    EdgeId* row_prev_edges) {
+  // The loop has no branches, so it is vectorized into compares and blends.
+  // The last edge of a route through a vertex is the last edge of its second
+  // half: that one is never missing, as routes ending in the intermediate
+  // vertex itself can't be improved.
+#pragma GCC ivdep
+  for (size_t column = 0; column < BLOCK_SIZE; ++column) {
+    const Weight candidate_weight = weight_to_through + through_weights[column];
+    const EdgeId is_better_mask =
+        -static_cast<EdgeId>(candidate_weight < row_weights[column]);
+    row_prev_edges[column] = (through_prev_edges[column] & is_better_mask) |
+                             (row_prev_edges[column] & ~is_better_mask);
+    row_weights[column] = std::min(row_weights[column], candidate_weight);
+  }
+}
+
+template <typename Weight>
+template <typename Work>
+void BlockedFloydWarshallRouter<Weight>::RunOnThreads(Work work) const {
+  Barrier barrier(thread_count_);
+  std::vector<std::thread> threads;
+  threads.reserve(thread_count_ - 1);
+  for (size_t thread_idx = 1; thread_idx < thread_count_; ++thread_idx) {
+    threads.emplace_back(
+        [&work, &barrier, thread_idx] { work(thread_idx, barrier); });
+  }
+  work(0, barrier);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+template <typename Weight>
+template <typename RelaxBlockRow>
+void BlockedFloydWarshallRouter<Weight>::ForEachBlockRow(
+    size_t thread_idx,
+    size_t skipped_block_row,
+    RelaxBlockRow relax_block_row) const {
+  for (size_t block_row = thread_idx; block_row < block_count_;
+       block_row += thread_count_) {
+    if (block_row != skipped_block_row) {
+      relax_block_row(block_row);
+    }
+  }
+}
+
+template <typename Weight>
+std::optional<Weight> BlockedFloydWarshallRouter<Weight>::WriteRoute(
+    VertexId from,
+    VertexId to,
+    std::vector<EdgeId>& edges) const {
+  const Weight weight = route_weights_[GetCellIndex(from, to)];
+  if (weight == INFINITE_WEIGHT) {
+    return std::nullopt;
+  }
+  edges.clear();
+  for (EdgeId edge_id = route_prev_edges_[GetCellIndex(from, to)];
+       edge_id != NO_EDGE; edge_id = route_prev_edges_[GetCellIndex(
+                               from, graph_.GetEdge(edge_id).from)]) {
+    edges.push_back(edge_id);
+  }
+  std::reverse(std::begin(edges), std::end(edges));
+
+  return weight;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>>
+BlockedFloydWarshallRouter<Weight>::ComputeRouteWeights(
+    VertexId from,
+    const std::vector<VertexId>& targets) const {
+  std::vector<std::optional<Weight>> weights;
+  weights.reserve(targets.size());
+  for (const VertexId to : targets) {
+    const Weight weight = route_weights_[GetCellIndex(from, to)];
+    weights.push_back(weight == INFINITE_WEIGHT ? std::nullopt
+                                                : std::optional(weight));
+  }
+  return weights;
+}
+
+template <typename Weight>
+void BlockedFloydWarshallRouter<Weight>::Serialize(
+    Serialization::Writer& writer) const {
+  writer.Write(static_cast<uint64_t>(stride_));
+  writer.WriteArray(route_weights_, stride_ * stride_);
+  writer.WriteArray(route_prev_edges_, stride_ * stride_);
+}
+
+}  // namespace Graph
@@ -0,0 +1,519 @@
+#pragma once
+
+#include "graph.h"
+#include "irouter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+// Contracts vertices one by one in order of importance, adding shortcut edges
+// which preserve shortest paths between the remaining ones. A query is then
+// a bidirectional search which only goes up the hierarchy, so it settles a
+// tiny part of the graph. Shortcuts are unpacked back into original edges.
+template <typename Weight>
+class ContractionHierarchiesRouter : public IRouter<Weight> {
+ private:
+  using Graph = DirectedWeightedGraph<Weight>;
+
+ public:
+  explicit ContractionHierarchiesRouter(const Graph& graph);
+  ContractionHierarchiesRouter(const Graph& graph,
+                               Serialization::Reader& reader);
+
+  using typename IRouter<Weight>::RouteInfo;
+
+  std::optional<Weight> WriteRoute(VertexId from,
+                                   VertexId to,
+                                   std::vector<EdgeId>& edges) const override;
+
+  // Runs a search per target, but unpacks nothing
+  std::vector<std::optional<Weight>> ComputeRouteWeights(
+      VertexId from,
+      const std::vector<VertexId>& targets) const override;
+
+  void Serialize(Serialization::Writer& writer) const override;
+
+  size_t ComputeMemoryUsage() const override;
+
+ private:
+  static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+  // Witness searches are cut after this many settled vertices, which may
+  // only lead to superfluous shortcuts
+  static constexpr size_t WITNESS_SEARCH_SETTLED_LIMIT = 64;
+
+  // Edges of the original graph keep their ids, shortcuts are appended
+  // and remember the pair of edges they replace
+  struct HierarchyEdge {
+    VertexId from;
+    VertexId to;
+    Weight weight;
+    EdgeId first_child = NO_EDGE;
+    EdgeId second_child = NO_EDGE;
+  };
+
+  struct ContractionState {
+    std::vector<std::vector<EdgeId>> in_edges;
+    std::vector<std::vector<EdgeId>> out_edges;
+    std::vector<size_t> contracted_neighbours;
+
+    // Scratch space of witness searches
+    std::vector<std::optional<Weight>> witness_weights;
+    std::vector<VertexId> witness_touched;
+    std::vector<bool> is_witness_target;
+  };
+
+  void BuildHierarchy(const Graph& graph);
+
+  void BuildSearchGraphs();
+
+  std::vector<HierarchyEdge> FindShortcuts(ContractionState& state,
+                                           VertexId vertex) const;
+
+  void RunWitnessSearch(ContractionState& state,
+                        VertexId source,
+                        VertexId excluded,
+                        Weight max_weight,
+                        size_t target_count) const;
+
+  int ComputePriority(const ContractionState& state,
+                      VertexId vertex,
+                      size_t shortcut_count) const;
+
+  // Detaches the vertex from the remaining graph
+  void ContractVertex(ContractionState& state, VertexId vertex) const;
+
+  struct SearchLabel {
+    Weight weight;
+    EdgeId edge;  // previous edge in forward search, next one in backward
+    bool settled = false;
+  };
+  using SearchLabels = std::unordered_map<VertexId, SearchLabel>;
+
+  struct SearchResult {
+    Weight weight;
+    VertexId meeting_vertex;
+  };
+
+  // Bidirectional search up the hierarchy, labels are left for unpacking
+  std::optional<SearchResult> Search(VertexId from,
+                                     VertexId to,
+                                     SearchLabels& forward_labels,
+                                     SearchLabels& backward_labels) const;
+
+  void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& route_edges) const;
+
+  std::vector<HierarchyEdge> edges_;
+  std::vector<size_t> ranks_;
+  std::vector<std::vector<EdgeId>> upward_edges_;
+  // Edges coming into a vertex from higher ranked ones
+  std::vector<std::vector<EdgeId>> downward_edges_;
+};
+
+template <typename Weight>
+ContractionHierarchiesRouter<Weight>::ContractionHierarchiesRouter(
+    const Graph& graph)
+    : ranks_(graph.GetVertexCount()),
+      upward_edges_(graph.GetVertexCount()),
+      downward_edges_(graph.GetVertexCount()) {
+  BuildHierarchy(graph);
+  BuildSearchGraphs();
+}
+
+template <typename Weight>
+ContractionHierarchiesRouter<Weight>::ContractionHierarchiesRouter(
+    const Graph& graph,
+    Serialization::Reader& reader)
+    : upward_edges_(graph.GetVertexCount()),
+      downward_edges_(graph.GetVertexCount()) {
+  const auto edges = reader.ReadArray<HierarchyEdge>();
+  edges_.assign(edges.begin(), edges.end());
+  const auto ranks = reader.ReadArray<size_t>();
+  ranks_.assign(ranks.begin(), ranks.end());
+  BuildSearchGraphs();
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::BuildHierarchy(const Graph& graph) {
+  const size_t vertex_count = graph.GetVertexCount();
+  ContractionState state{
+      std::vector<std::vector<EdgeId>>(vertex_count),
+      std::vector<std::vector<EdgeId>>(vertex_count),
+      std::vector<size_t>(vertex_count, 0),
+      std::vector<std::optional<Weight>>(vertex_count),
+      {},
+      std::vector<bool>(vertex_count, false),
+  };
+
+  edges_.reserve(graph.GetEdgeCount());
+  for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+    const auto& edge = graph.GetEdge(edge_id);
+    assert(edge.weight >= 0);
+    edges_.push_back({edge.from, edge.to, edge.weight});
+    if (edge.from != edge.to) {
+      state.out_edges[edge.from].push_back(edge_id);
+      state.in_edges[edge.to].push_back(edge_id);
+    }
+  }
+
+  using QueueItem = std::pair<int, VertexId>;
+  std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+      queue;
+  for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+    queue.push({ComputePriority(state, vertex,
+                                FindShortcuts(state, vertex).size()),
+                vertex});
+  }
+
+  size_t next_rank = 0;
+  while (!queue.empty()) {
+    const VertexId vertex = queue.top().second;
+    queue.pop();
+    // Priorities go stale as neighbours get contracted, so they are
+    // recomputed lazily when a vertex reaches the top
+    std::vector<HierarchyEdge> shortcuts = FindShortcuts(state, vertex);
+    const int priority = ComputePriority(state, vertex, shortcuts.size());
+    if (!queue.empty() && priority > queue.top().first) {
+      queue.push({priority, vertex});
+      continue;
+    }
+
+    for (const HierarchyEdge& shortcut : shortcuts) {
+      const EdgeId edge_id = edges_.size();
+      edges_.push_back(shortcut);
+      state.out_edges[shortcut.from].push_back(edge_id);
+      state.in_edges[shortcut.to].push_back(edge_id);
+    }
+    ContractVertex(state, vertex);
+    ranks_[vertex] = next_rank++;
+  }
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::BuildSearchGraphs() {
+  for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+    const auto& edge = edges_[edge_id];
+    if (edge.from == edge.to) {
+      continue;
+    }
+    if (ranks_[edge.from] < ranks_[edge.to]) {
+      upward_edges_[edge.from].push_back(edge_id);
+    } else {
+      downward_edges_[edge.to].push_back(edge_id);
+    }
+  }
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::RunWitnessSearch(
+    ContractionState& state,
+    VertexId source,
+    VertexId excluded,
+    Weight max_weight,
+    size_t target_count) const {
+  for (const VertexId vertex : state.witness_touched) {
+    state.witness_weights[vertex].reset();
+  }
+  state.witness_touched.clear();
+
+  using QueueItem = std::pair<Weight, VertexId>;
+  std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+      queue;
+  state.witness_weights[source] = 0;
+  state.witness_touched.push_back(source);
+  queue.push({0, source});
+  size_t settled_count = 0;
+  while (!queue.empty() && settled_count < WITNESS_SEARCH_SETTLED_LIMIT) {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    if (weight > *state.witness_weights[vertex]) {
+      continue;
+    }
+    if (weight > max_weight) {
+      break;
+    }
+    if (state.is_witness_target[vertex] && --target_count == 0) {
+      break;
+    }
+    ++settled_count;
+    for (const EdgeId edge_id : state.out_edges[vertex]) {
+      const auto& edge = edges_[edge_id];
+      if (edge.to == excluded) {
+        continue;
+      }
+      const Weight candidate_weight = weight + edge.weight;
+      auto& target_weight = state.witness_weights[edge.to];
+      if (!target_weight || candidate_weight < *target_weight) {
+        if (!target_weight) {
+          state.witness_touched.push_back(edge.to);
+        }
+        target_weight = candidate_weight;
+        queue.push({candidate_weight, edge.to});
+      }
+    }
+  }
+}
+
+template <typename Weight>
+std::vector<typename ContractionHierarchiesRouter<Weight>::HierarchyEdge>
+ContractionHierarchiesRouter<Weight>::FindShortcuts(ContractionState& state,
+                                                    VertexId vertex) const {
+  // Cheapest edge to every neighbour, parallel edges are of no use
+  auto collect_cheapest = [&](const std::vector<EdgeId>& edge_ids,
+                              bool take_source) {
+    std::unordered_map<VertexId, EdgeId> cheapest;
+    for (const EdgeId edge_id : edge_ids) {
+      const auto& edge = edges_[edge_id];
+      const VertexId neighbour = take_source ? edge.from : edge.to;
+      auto [it, inserted] = cheapest.emplace(neighbour, edge_id);
+      if (!inserted && edge.weight < edges_[it->second].weight) {
+        it->second = edge_id;
+      }
+    }
+    return cheapest;
+  };
+  const auto in_edges = collect_cheapest(state.in_edges[vertex], true);
+  const auto out_edges = collect_cheapest(state.out_edges[vertex], false);
+
+  std::vector<HierarchyEdge> shortcuts;
+  if (out_edges.empty()) {
+    return shortcuts;
+  }
+  Weight max_out_weight = 0;
+  for (const auto& [target, out_edge_id] : out_edges) {
+    max_out_weight = std::max(max_out_weight, edges_[out_edge_id].weight);
+    state.is_witness_target[target] = true;
+  }
+  for (const auto& [source, in_edge_id] : in_edges) {
+    const Weight in_weight = edges_[in_edge_id].weight;
+    RunWitnessSearch(state, source, vertex, in_weight + max_out_weight,
+                     out_edges.size());
+
+    for (const auto& [target, out_edge_id] : out_edges) {
+      if (target == source) {
+        continue;
+      }
+      const Weight shortcut_weight = in_weight + edges_[out_edge_id].weight;
+      const auto& witness_weight = state.witness_weights[target];
+      if (witness_weight && *witness_weight <= shortcut_weight) {
+        continue;
+      }
+      shortcuts.push_back(
+          {source, target, shortcut_weight, in_edge_id, out_edge_id});
+    }
+  }
+  for (const auto& [target, _] : out_edges) {
+    state.is_witness_target[target] = false;
+  }
+  return shortcuts;
+}
+
+template <typename Weight>
+int ContractionHierarchiesRouter<Weight>::ComputePriority(
+    const ContractionState& state,
+    VertexId vertex,
+    size_t shortcut_count) const {
+  const size_t removed_edge_count =
+      state.in_edges[vertex].size() + state.out_edges[vertex].size();
+  return static_cast<int>(shortcut_count) -
+         static_cast<int>(removed_edge_count) +
+         static_cast<int>(state.contracted_neighbours[vertex]);
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::ContractVertex(
+    ContractionState& state,
+    VertexId vertex) const {
+  auto detach = [this, vertex](std::vector<EdgeId>& edge_ids) {
+    edge_ids.erase(std::remove_if(std::begin(edge_ids), std::end(edge_ids),
+                                  [this, vertex](EdgeId edge_id) {
+                                    return edges_[edge_id].from == vertex ||
+                                           edges_[edge_id].to == vertex;
+                                  }),
+                   std::end(edge_ids));
+  };
+  for (const EdgeId edge_id : state.in_edges[vertex]) {
+    const VertexId neighbour = edges_[edge_id].from;
+    ++state.contracted_neighbours[neighbour];
+    detach(state.out_edges[neighbour]);
+  }
+  for (const EdgeId edge_id : state.out_edges[vertex]) {
+    const VertexId neighbour = edges_[edge_id].to;
+    ++state.contracted_neighbours[neighbour];
+    detach(state.in_edges[neighbour]);
+  }
+  state.in_edges[vertex].clear();
+  state.out_edges[vertex].clear();
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::UnpackEdge(
+    EdgeId edge_id,
+    std::vector<EdgeId>& route_edges) const {
+  std::vector<EdgeId> stack = {edge_id};
+  while (!stack.empty()) {
+    const EdgeId current_id = stack.back();
+    stack.pop_back();
+    const auto& edge = edges_[current_id];
+    if (edge.first_child == NO_EDGE) {
+      route_edges.push_back(current_id);
+    } else {
+      stack.push_back(edge.second_child);
+      stack.push_back(edge.first_child);
+    }
+  }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchiesRouter<Weight>::SearchResult>
+ContractionHierarchiesRouter<Weight>::Search(
+    VertexId from,
+    VertexId to,
+    SearchLabels& forward_labels,
+    SearchLabels& backward_labels) const {
+  using QueueItem = std::pair<Weight, VertexId>;
+  using Queue =
+      std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>;
+
+  forward_labels = {{from, {0, NO_EDGE}}};
+  backward_labels = {{to, {0, NO_EDGE}}};
+  Queue forward_queue, backward_queue;
+  forward_queue.push({0, from});
+  backward_queue.push({0, to});
+
+  std::optional<Weight> best_weight;
+  VertexId meeting_vertex = from;
+
+  auto search_step = [&](Queue& queue, SearchLabels& labels,
+                         const SearchLabels& other_labels,
+                         const std::vector<std::vector<EdgeId>>& edges,
+                         bool is_forward) {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    auto& label = labels.at(vertex);
+    if (label.settled) {
+      return;
+    }
+    label.settled = true;
+    if (auto it = other_labels.find(vertex); it != other_labels.end()) {
+      const Weight candidate_weight = weight + it->second.weight;
+      if (!best_weight || candidate_weight < *best_weight) {
+        best_weight = candidate_weight;
+        meeting_vertex = vertex;
+      }
+    }
+    for (const EdgeId edge_id : edges[vertex]) {
+      const auto& edge = edges_[edge_id];
+      const VertexId next_vertex = is_forward ? edge.to : edge.from;
+      const Weight candidate_weight = weight + edge.weight;
+      auto [it, inserted] =
+          labels.emplace(next_vertex, SearchLabel{candidate_weight, edge_id});
+      if (inserted) {
+        queue.push({candidate_weight, next_vertex});
+      } else if (!it->second.settled && candidate_weight < it->second.weight) {
+        it->second = {candidate_weight, edge_id};
+        queue.push({candidate_weight, next_vertex});
+      }
+    }
+  };
+
+  auto is_done = [&best_weight](const Queue& queue) {
+    return queue.empty() || (best_weight && queue.top().first >= *best_weight);
+  };
+  while (!is_done(forward_queue) || !is_done(backward_queue)) {
+    if (is_done(backward_queue) ||
+        (!is_done(forward_queue) &&
+         forward_queue.top().first <= backward_queue.top().first)) {
+      search_step(forward_queue, forward_labels, backward_labels,
+                  upward_edges_, true);
+    } else {
+      search_step(backward_queue, backward_labels, forward_labels,
+                  downward_edges_, false);
+    }
+  }
+
+  if (!best_weight) {
+    return std::nullopt;
+  }
+  return SearchResult{*best_weight, meeting_vertex};
+}
+
+template <typename Weight>
+std::optional<Weight> ContractionHierarchiesRouter<Weight>::WriteRoute(
+    VertexId from,
+    VertexId to,
+    std::vector<EdgeId>& edges) const {
+  SearchLabels forward_labels, backward_labels;
+  const auto result = Search(from, to, forward_labels, backward_labels);
+  if (!result) {
+    return std::nullopt;
+  }
+  const VertexId meeting_vertex = result->meeting_vertex;
+
+  std::vector<EdgeId> hierarchy_edges;
+  for (EdgeId edge_id = forward_labels.at(meeting_vertex).edge;
+       edge_id != NO_EDGE;
+       edge_id = forward_labels.at(edges_[edge_id].from).edge) {
+    hierarchy_edges.push_back(edge_id);
+  }
+  std::reverse(std::begin(hierarchy_edges), std::end(hierarchy_edges));
+  for (EdgeId edge_id = backward_labels.at(meeting_vertex).edge;
+       edge_id != NO_EDGE;
+       edge_id = backward_labels.at(edges_[edge_id].to).edge) {
+    hierarchy_edges.push_back(edge_id);
+  }
+
+  edges.clear();
+  for (const EdgeId edge_id : hierarchy_edges) {
+    UnpackEdge(edge_id, edges);
+  }
+
+  return result->weight;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>>
+ContractionHierarchiesRouter<Weight>::ComputeRouteWeights(
+    VertexId from,
+    const std::vector<VertexId>& targets) const {
+  std::vector<std::optional<Weight>> weights;
+  weights.reserve(targets.size());
+  SearchLabels forward_labels, backward_labels;
+  for (const VertexId to : targets) {
+    const auto result = Search(from, to, forward_labels, backward_labels);
+    weights.push_back(result ? std::optional(result->weight) : std::nullopt);
+  }
+  return weights;
+}
+
+template <typename Weight>
+size_t ContractionHierarchiesRouter<Weight>::ComputeMemoryUsage() const {
+  size_t bytes = GetCapacityBytes(edges_) + GetCapacityBytes(ranks_) +
+                 GetCapacityBytes(upward_edges_) +
+                 GetCapacityBytes(downward_edges_);
+  for (const auto& edges : upward_edges_) {
+    bytes += GetCapacityBytes(edges);
+  }
+  for (const auto& edges : downward_edges_) {
+    bytes += GetCapacityBytes(edges);
+  }
+  return bytes;
+}
+
+template <typename Weight>
+void ContractionHierarchiesRouter<Weight>::Serialize(
+    Serialization::Writer& writer) const {
+  writer.WriteArray(edges_.data(), edges_.size());
+  writer.WriteArray(ranks_.data(), ranks_.size());
+}
+
+}  // namespace Graph
@@ -1,70 +1,429 @@
 #include "descriptions.h"
 
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_set>
+
 using namespace std;
 
 namespace Descriptions {
 
-Stop Stop::ParseFrom(const Json::Dict& attrs) {
-  Stop stop = {.name = attrs.at("name").AsString(),
+Stop Stop::ParseFrom(const Json::Dict& attrs, const NameRegistry& stop_names) {
+  Stop stop = {.id = stop_names.GetId(attrs.at("name").AsString()),
                .position = {
                    .latitude = attrs.at("latitude").AsDouble(),
                    .longitude = attrs.at("longitude").AsDouble(),
-               }};
+               },
+               .distances = {},
+               .pending_distances = {}};
   if (attrs.count("road_distances") > 0) {
-    for (const auto& [neighbour_stop, distance_node] :
-         attrs.at("road_distances").AsMap()) {
-      stop.distances[neighbour_stop] = distance_node.AsInt();
+    const auto& distances = attrs.at("road_distances").AsMap();
+    stop.distances.reserve(distances.size());
+    for (const auto& [neighbour_stop, distance_node] : distances) {
+      if (const auto neighbour_id = stop_names.Find(neighbour_stop)) {
+        stop.distances.emplace_back(*neighbour_id, distance_node.AsInt());
+      } else {
+        stop.pending_distances.emplace_back(neighbour_stop,
+                                            distance_node.AsInt());
+      }
     }
   }
   return stop;
 }
 
-vector<string> ParseStops(const vector<Json::Node>& stop_nodes,
-                          bool is_roundtrip) {
-  vector<string> stops;
-  stops.reserve(stop_nodes.size());
-  for (const Json::Node& stop_node : stop_nodes) {
-    stops.push_back(stop_node.AsString());
+// The end stop is not repeated
+void AddWayBack(vector<StopId>& stops) {
+  if (stops.size() <= 1) {
+    return;
   }
-  if (is_roundtrip || stops.size() <= 1) {
-    return stops;
-  }
-  stops.reserve(stops.size() * 2 - 1);  // end stop is not repeated
+  stops.reserve(stops.size() * 2 - 1);
   for (size_t stop_idx = stops.size() - 1; stop_idx > 0; --stop_idx) {
     stops.push_back(stops[stop_idx - 1]);
   }
+}
+
+vector<StopId> ParseStops(const Json::Array& stop_nodes,
+                          bool is_roundtrip,
+                          const NameRegistry& stop_names) {
+  vector<StopId> stops;
+  stops.reserve(stop_nodes.size());
+  for (const Json::Node& stop_node : stop_nodes) {
+    stops.push_back(stop_names.GetId(stop_node.AsString()));
+  }
+  if (!is_roundtrip) {
+    AddWayBack(stops);
+  }
   return stops;
 }
 
-int ComputeStopsDistance(const Stop& lhs, const Stop& rhs) {
-  if (auto it = lhs.distances.find(rhs.name); it != lhs.distances.end()) {
-    return it->second;
-  } else {
-    return rhs.distances.at(lhs.name);
+const int* FindDistance(const Stop& from, StopId to) {
+  const auto it =
+      find_if(begin(from.distances), end(from.distances),
+              [to](const auto& distance) { return distance.first == to; });
+  return it != end(from.distances) ? &it->second : nullptr;
+}
+
+RoadDistances::RoadDistances(const vector<Stop>& stops)
+    : offsets_(stops.size() + 1, 0) {
+  auto for_each_distance = [&stops](auto callback) {
+    for (const Stop& stop : stops) {
+      for (const auto& [neighbour_id, distance] : stop.distances) {
+        callback(stop.id, neighbour_id, distance);
+        if (!FindDistance(stops[neighbour_id], stop.id)) {
+          callback(neighbour_id, stop.id, distance);
+        }
+      }
+    }
+  };
+
+  for_each_distance([this](StopId from, StopId, int) { ++offsets_[from + 1]; });
+  for (size_t stop_id = 0; stop_id < stops.size(); ++stop_id) {
+    offsets_[stop_id + 1] += offsets_[stop_id];
+  }
+
+  entries_.resize(offsets_.back());
+  vector<uint32_t> next_entry_idx(begin(offsets_), prev(end(offsets_)));
+  for_each_distance([this, &next_entry_idx](StopId from, StopId to,
+                                            int distance) {
+    entries_[next_entry_idx[from]++] = {to, distance};
+  });
+  for (size_t stop_id = 0; stop_id < stops.size(); ++stop_id) {
+    sort(begin(entries_) + offsets_[stop_id],
+         begin(entries_) + offsets_[stop_id + 1],
+         [](const Entry& lhs, const Entry& rhs) {
+           return lhs.neighbour_id < rhs.neighbour_id;
+         });
   }
 }
 
-Bus Bus::ParseFrom(const Json::Dict& attrs) {
+int RoadDistances::Get(StopId from, StopId to) const {
+  const auto row_begin = begin(entries_) + offsets_[from];
+  const auto row_end = begin(entries_) + offsets_[from + 1];
+  const auto it = lower_bound(
+      row_begin, row_end, to,
+      [](const Entry& entry, StopId id) { return entry.neighbour_id < id; });
+  if (it == row_end || it->neighbour_id != to) {
+    throw out_of_range("no road distance between stops");
+  }
+  return it->distance;
+}
+
+Bus Bus::ParseFrom(const Json::Dict& attrs,
+                   const NameRegistry& bus_names,
+                   const NameRegistry& stop_names) {
   return Bus{
-      .name = attrs.at("name").AsString(),
+      .id = bus_names.GetId(attrs.at("name").AsString()),
       .stops = ParseStops(attrs.at("stops").AsArray(),
-                          attrs.at("is_roundtrip").AsBool()),
+                          attrs.at("is_roundtrip").AsBool(), stop_names),
   };
 }
 
-vector<InputQuery> ReadDescriptions(const vector<Json::Node>& nodes) {
-  vector<InputQuery> result;
-  result.reserve(nodes.size());
+bool IsBusDescription(const Json::Dict& node_dict) {
+  return node_dict.at("type").AsString() == "Bus";
+}
+
+bool IsRemoval(const Json::Dict& node_dict) {
+  const auto it = node_dict.find("removed");
+  return it != node_dict.end() && it->second.AsBool();
+}
+
+Input ReadDescriptions(const Json::Array& nodes) {
+  Input result;
+  UpdateDescriptions(result, nodes);
+  return result;
+}
+
+bool IsExtension(const Input& input, const Json::Array& nodes) {
+  for (const Json::Node& node : nodes) {
+    const auto& node_dict = node.AsMap();
+    const auto& names =
+        IsBusDescription(node_dict) ? input.bus_names : input.stop_names;
+    if (IsRemoval(node_dict) || names.Find(node_dict.at("name").AsString())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+using IdMap = vector<optional<NameRegistry::Id>>;
+
+// Keeps the other names in their order, returns their new ids by old ones
+IdMap RemoveNames(NameRegistry& names,
+                  const unordered_set<string_view>& removed_names) {
+  NameRegistry kept_names;
+  IdMap new_ids(names.GetSize());
+  for (NameRegistry::Id id = 0; id < names.GetSize(); ++id) {
+    if (removed_names.count(names.GetName(id)) == 0) {
+      new_ids[id] = kept_names.Intern(names.GetName(id));
+    }
+  }
+  names = move(kept_names);
+  return new_ids;
+}
+
+void RemoveDescriptions(Input& input, const Json::Array& nodes) {
+  unordered_set<string_view> removed_stops;
+  unordered_set<string_view> removed_buses;
+  unordered_set<string_view> described_buses;
+  for (const Json::Node& node : nodes) {
+    const auto& node_dict = node.AsMap();
+    const string_view name = node_dict.at("name").AsString();
+    if (!IsBusDescription(node_dict)) {
+      if (IsRemoval(node_dict)) {
+        removed_stops.insert(name);
+      }
+    } else if (IsRemoval(node_dict)) {
+      removed_buses.insert(name);
+    } else {
+      described_buses.insert(name);
+    }
+  }
+  if (removed_stops.empty() && removed_buses.empty()) {
+    return;
+  }
+
+  for (Bus& bus : input.buses) {
+    const string& bus_name = input.bus_names.GetName(bus.id);
+    if (removed_buses.count(bus_name) > 0) {
+      continue;
+    }
+    if (described_buses.count(bus_name) > 0) {
+      bus.stops.clear();  // to be replaced
+      continue;
+    }
+    for (const StopId stop_id : bus.stops) {
+      const string& stop_name = input.stop_names.GetName(stop_id);
+      if (removed_stops.count(stop_name) > 0) {
+        throw invalid_argument("bus " + bus_name + " goes through stop " +
+                               stop_name + " to be removed");
+      }
+    }
+  }
+
+  // Kept by name in case the stop is described again
+  for (Stop& stop : input.stops) {
+    for (const auto& [neighbour_id, distance] : stop.distances) {
+      const string& neighbour_name = input.stop_names.GetName(neighbour_id);
+      if (removed_stops.count(neighbour_name) > 0) {
+        stop.pending_distances.emplace_back(neighbour_name, distance);
+      }
+    }
+  }
+
+  const IdMap stop_ids = RemoveNames(input.stop_names, removed_stops);
+  const IdMap bus_ids = RemoveNames(input.bus_names, removed_buses);
+
+  vector<Stop> stops;
+  stops.reserve(input.stop_names.GetSize());
+  for (Stop& stop : input.stops) {
+    if (const auto stop_id = stop_ids[stop.id]) {
+      stop.id = *stop_id;
+      auto& distances = stop.distances;
+      distances.erase(remove_if(begin(distances), end(distances),
+                                [&stop_ids](const auto& distance) {
+                                  return !stop_ids[distance.first];
+                                }),
+                      end(distances));
+      for (auto& distance : distances) {
+        distance.first = *stop_ids[distance.first];
+      }
+      stops.push_back(move(stop));
+    }
+  }
+  input.stops = move(stops);
+
+  vector<Bus> buses;
+  buses.reserve(input.bus_names.GetSize());
+  for (Bus& bus : input.buses) {
+    if (const auto bus_id = bus_ids[bus.id]) {
+      bus.id = *bus_id;
+      for (StopId& stop_id : bus.stops) {
+        stop_id = *stop_ids[stop_id];
+      }
+      buses.push_back(move(bus));
+    }
+  }
+  input.buses = move(buses);
+}
+
+// Takes a pass over all stops, as any of them may wait for a new one
+void ResolvePendingDistances(Input& input) {
+  for (Stop& stop : input.stops) {
+    auto& pending_distances = stop.pending_distances;
+    auto is_resolved = [&input, &stop](const auto& pending_distance) {
+      const auto neighbour_id = input.stop_names.Find(pending_distance.first);
+      if (!neighbour_id) {
+        return false;
+      }
+      if (!FindDistance(stop, *neighbour_id)) {
+        stop.distances.emplace_back(*neighbour_id, pending_distance.second);
+      }
+      return true;
+    };
+    pending_distances.erase(remove_if(begin(pending_distances),
+                                      end(pending_distances), is_resolved),
+                            end(pending_distances));
+  }
+}
+
+void UpdateDescriptions(Input& input, const Json::Array& nodes) {
+  RemoveDescriptions(input, nodes);
+
+  // Names go first, as descriptions refer to stops described later
+  for (const Json::Node& node : nodes) {
+    const auto& node_dict = node.AsMap();
+    if (IsRemoval(node_dict)) {
+      continue;
+    }
+    auto& names =
+        IsBusDescription(node_dict) ? input.bus_names : input.stop_names;
+    names.Intern(node_dict.at("name").AsString());
+  }
 
+  input.stops.resize(input.stop_names.GetSize());
+  input.buses.resize(input.bus_names.GetSize());
   for (const Json::Node& node : nodes) {
     const auto& node_dict = node.AsMap();
-    if (node_dict.at("type").AsString() == "Bus") {
-      result.push_back(Bus::ParseFrom(node_dict));
+    if (IsRemoval(node_dict)) {
+      continue;
+    }
+    if (IsBusDescription(node_dict)) {
+      Bus bus = Bus::ParseFrom(node_dict, input.bus_names, input.stop_names);
+      input.buses[bus.id] = move(bus);
+    } else {
+      Stop stop = Stop::ParseFrom(node_dict, input.stop_names);
+      input.stops[stop.id] = move(stop);
+    }
+  }
+
+  ResolvePendingDistances(input);
+  input.road_distances = RoadDistances(input.stops);
+}
+
+// Fields of either kind, as the type may come after the others. Stops get
+// ids of the names they are referred to by at first sight.
+struct StreamedDescription {
+  bool is_bus = false;
+  bool is_removal = false;
+  string_view name;
+  Sphere::Point position;
+  vector<pair<StopId, int>> distances;
+  vector<StopId> stops;
+  bool is_roundtrip = false;
+};
+
+StreamedDescription ReadDescription(Json::Reader& reader,
+                                    NameRegistry& stop_names) {
+  StreamedDescription description;
+  reader.BeginObject();
+  while (const auto key = reader.NextKey()) {
+    if (*key == "type") {
+      description.is_bus = reader.ReadString() == "Bus";
+    } else if (*key == "name") {
+      description.name = reader.ReadString();
+    } else if (*key == "removed") {
+      description.is_removal = reader.ReadBool();
+    } else if (*key == "latitude") {
+      description.position.latitude = reader.ReadDouble();
+    } else if (*key == "longitude") {
+      description.position.longitude = reader.ReadDouble();
+    } else if (*key == "road_distances") {
+      reader.BeginObject();
+      while (const auto neighbour_stop = reader.NextKey()) {
+        const StopId neighbour_id = stop_names.Intern(*neighbour_stop);
+        description.distances.emplace_back(neighbour_id, reader.ReadInt());
+      }
+    } else if (*key == "stops") {
+      reader.BeginArray();
+      while (reader.NextItem()) {
+        description.stops.push_back(stop_names.Intern(reader.ReadString()));
+      }
+    } else if (*key == "is_roundtrip") {
+      description.is_roundtrip = reader.ReadBool();
     } else {
-      result.push_back(Stop::ParseFrom(node_dict));
+      reader.SkipValue();
+    }
+  }
+  return description;
+}
+
+// Ids end up the same as ReadDescriptions of nodes gives, ordered by the
+// first description of a name
+Input ReadDescriptions(Json::Reader& reader) {
+  // Descriptions refer to stops described later, so stops get temporary
+  // ids here, and described ones are renumbered once all are read
+  NameRegistry seen_stop_names;
+  vector<Stop> seen_stops;
+  vector<StopId> described_stop_ids;
+  Input result;
+
+  reader.BeginArray();
+  while (reader.NextItem()) {
+    StreamedDescription description = ReadDescription(reader, seen_stop_names);
+    if (description.is_removal) {
+      continue;
+    }
+    if (description.is_bus) {
+      if (!description.is_roundtrip) {
+        AddWayBack(description.stops);
+      }
+      const BusId id = result.bus_names.Intern(description.name);
+      if (id == result.buses.size()) {
+        result.buses.emplace_back();
+      }
+      result.buses[id] = {.id = id, .stops = move(description.stops)};
+    } else {
+      const StopId id = seen_stop_names.Intern(description.name);
+      if (id >= seen_stops.size()) {
+        seen_stops.resize(seen_stop_names.GetSize());
+      }
+      if (!result.stop_names.Find(description.name)) {
+        result.stop_names.Intern(description.name);
+        described_stop_ids.push_back(id);
+      }
+      seen_stops[id] = {.id = id,
+                        .position = description.position,
+                        .distances = move(description.distances),
+                        .pending_distances = {}};
+    }
+  }
+
+  // Described stops got ids of result.stop_names in the same order
+  IdMap stop_ids(seen_stop_names.GetSize());
+  for (StopId id = 0; id < described_stop_ids.size(); ++id) {
+    stop_ids[described_stop_ids[id]] = id;
+  }
+
+  result.stops.reserve(described_stop_ids.size());
+  for (const StopId seen_id : described_stop_ids) {
+    Stop& stop = seen_stops[seen_id];
+    stop.id = *stop_ids[seen_id];
+    vector<pair<StopId, int>> distances;
+    distances.reserve(stop.distances.size());
+    for (const auto& [neighbour_id, distance] : stop.distances) {
+      if (const auto described_id = stop_ids[neighbour_id]) {
+        distances.emplace_back(*described_id, distance);
+      } else {
+        stop.pending_distances.emplace_back(
+            seen_stop_names.GetName(neighbour_id), distance);
+      }
+    }
+    stop.distances = move(distances);
+    result.stops.push_back(move(stop));
+  }
+
+  for (Bus& bus : result.buses) {
+    for (StopId& stop_id : bus.stops) {
+      if (!stop_ids[stop_id]) {
+        throw out_of_range("unknown name: " + seen_stop_names.GetName(stop_id));
+      }
+      stop_id = *stop_ids[stop_id];
     }
   }
 
+  result.road_distances = RoadDistances(result.stops);
   return result;
 }
 
@@ -1,41 +1,87 @@
 #pragma once
 
 #include "json.h"
+#include "name_registry.h"
 #include "sphere.h"
 
+#include <cstdint>
 #include <string>
-#include <unordered_map>
-#include <variant>
+#include <utility>
 #include <vector>
 
 namespace Descriptions {
+using StopId = NameRegistry::Id;
+using BusId = NameRegistry::Id;
+
 struct Stop {
-  std::string name;
+  StopId id;
   Sphere::Point position;
-  std::unordered_map<std::string, int> distances;
+  // Stops have few neighbours, so a linear search beats hashing
+  std::vector<std::pair<StopId, int>> distances;
+  // To stops not described yet, resolved once they are
+  std::vector<std::pair<std::string, int>> pending_distances;
 
-  static Stop ParseFrom(const Json::Dict& attrs);
+  static Stop ParseFrom(const Json::Dict& attrs,
+                        const NameRegistry& stop_names);
 };
 
-int ComputeStopsDistance(const Stop& lhs, const Stop& rhs);
+// Road distances of all stops in one table indexed by stop ids, where a
+// distance given one way only serves the way back as well
+class RoadDistances {
+ public:
+  RoadDistances() = default;
+  // Stops are indexed by StopId
+  explicit RoadDistances(const std::vector<Stop>& stops);
+
+  // Throws out_of_range if the distance is given neither way
+  int Get(StopId from, StopId to) const;
 
-std::vector<std::string> ParseStops(const std::vector<Json::Node>& stop_nodes,
-                                    bool is_roundtrip);
+ private:
+  struct Entry {
+    StopId neighbour_id;
+    int distance;
+  };
+
+  // Neighbours of stop s are entries_[offsets_[s]..[s + 1]), sorted by id
+  std::vector<uint32_t> offsets_;
+  std::vector<Entry> entries_;
+};
+
+std::vector<StopId> ParseStops(const Json::Array& stop_nodes,
+                               bool is_roundtrip,
+                               const NameRegistry& stop_names);
 
 struct Bus {
-  std::string name;
-  std::vector<std::string> stops;
+  BusId id;
+  std::vector<StopId> stops;
+
+  static Bus ParseFrom(const Json::Dict& attrs,
+                       const NameRegistry& bus_names,
+                       const NameRegistry& stop_names);
+};
 
-  static Bus ParseFrom(const Json::Dict& attrs);
+// Ids are assigned to described stops and buses only, the vectors are
+// indexed by them
+struct Input {
+  NameRegistry stop_names;
+  NameRegistry bus_names;
+  std::vector<Stop> stops;
+  std::vector<Bus> buses;
+  // Of the stops above, built once they are read or updated
+  RoadDistances road_distances;
 };
 
-using InputQuery = std::variant<Stop, Bus>;
+Input ReadDescriptions(const Json::Array& nodes);
 
-std::vector<InputQuery> ReadDescriptions(const std::vector<Json::Node>& nodes);
+// The same from the array of descriptions next in reader, without nodes
+Input ReadDescriptions(Json::Reader& reader);
 
-template <typename Object>
-using Dict = std::unordered_map<std::string, const Object*>;
+// True if nodes describe stops and buses with new names only
+bool IsExtension(const Input& input, const Json::Array& nodes);
 
-using StopsDict = Dict<Stop>;
-using BusesDict = Dict<Bus>;
+// New names get next ids, known ones are described anew, and
+// {"type", "name", "removed": true} drops a stop or a bus with the rest
+// renumbered in their order. A stop can't be dropped while some bus not
+// described anew goes through it.
+void UpdateDescriptions(Input& input, const Json::Array& nodes);
 }  // namespace Descriptions
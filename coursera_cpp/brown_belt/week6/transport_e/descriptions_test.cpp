@@ -0,0 +1,186 @@
+#include "descriptions_test.h"
+#include "descriptions.h"
+#include "json.h"
+#include "test_runner.h"
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace Descriptions {
+
+const string_view BASE_NODES = R"([
+  {"type": "Stop", "name": "A", "latitude": 55.0, "longitude": 37.0,
+   "road_distances": {"B": 1000}},
+  {"type": "Bus", "name": "1", "stops": ["A", "B"], "is_roundtrip": false},
+  {"type": "Stop", "name": "B", "latitude": 55.1, "longitude": 37.1,
+   "road_distances": {"C": 2000}},
+  {"type": "Stop", "name": "C", "latitude": 55.2, "longitude": 37.2},
+  {"type": "Bus", "name": "2", "stops": ["B", "C"], "is_roundtrip": false}
+])";
+
+// New names only, D waits for E
+const string_view EXTENSION_NODES = R"([
+  {"type": "Stop", "name": "D", "latitude": 55.3, "longitude": 37.3,
+   "road_distances": {"E": 500, "A": 700}},
+  {"type": "Bus", "name": "3", "stops": ["A", "D"], "is_roundtrip": false}
+])";
+
+// Describes A and bus 1 anew, drops bus 2 with C, and describes E
+const string_view CHANGE_NODES = R"([
+  {"type": "Stop", "name": "A", "latitude": 55.05, "longitude": 37.05,
+   "road_distances": {"B": 1100}},
+  {"type": "Bus", "name": "1", "stops": ["A", "B", "D"],
+   "is_roundtrip": false},
+  {"type": "Bus", "name": "2", "removed": true},
+  {"type": "Stop", "name": "C", "removed": true},
+  {"type": "Stop", "name": "E", "latitude": 55.4, "longitude": 37.4}
+])";
+
+// What the changes above come to
+const string_view COMBINED_NODES = R"([
+  {"type": "Stop", "name": "A", "latitude": 55.05, "longitude": 37.05,
+   "road_distances": {"B": 1100}},
+  {"type": "Bus", "name": "1", "stops": ["A", "B", "D"],
+   "is_roundtrip": false},
+  {"type": "Stop", "name": "B", "latitude": 55.1, "longitude": 37.1,
+   "road_distances": {"C": 2000}},
+  {"type": "Stop", "name": "D", "latitude": 55.3, "longitude": 37.3,
+   "road_distances": {"E": 500, "A": 700}},
+  {"type": "Bus", "name": "3", "stops": ["A", "D"], "is_roundtrip": false},
+  {"type": "Stop", "name": "E", "latitude": 55.4, "longitude": 37.4}
+])";
+
+vector<string> GetNames(const NameRegistry& names) {
+  vector<string> result;
+  for (NameRegistry::Id id = 0; id < names.GetSize(); ++id) {
+    result.push_back(names.GetName(id));
+  }
+  return result;
+}
+
+// By names, as the same stops may get other ids
+map<string, int> GetDistances(const Input& input, const Stop& stop) {
+  map<string, int> result;
+  for (const auto& [neighbour_id, distance] : stop.distances) {
+    result[input.stop_names.GetName(neighbour_id)] = distance;
+  }
+  return result;
+}
+
+map<string, int> GetPendingDistances(const Stop& stop) {
+  return {begin(stop.pending_distances), end(stop.pending_distances)};
+}
+
+map<string, int> GetRoadDistances(const Input& input) {
+  map<string, int> result;
+  for (const Stop& from : input.stops) {
+    for (const Stop& to : input.stops) {
+      try {
+        result[input.stop_names.GetName(from.id) + " -> " +
+               input.stop_names.GetName(to.id)] =
+            input.road_distances.Get(from.id, to.id);
+      } catch (const out_of_range&) {
+      }
+    }
+  }
+  return result;
+}
+
+void AssertSameDescriptions(const Input& lhs, const Input& rhs) {
+  ASSERT_EQUAL(GetNames(lhs.stop_names).size(), lhs.stops.size());
+  ASSERT_EQUAL(GetNames(lhs.bus_names).size(), lhs.buses.size());
+  ASSERT_EQUAL(lhs.stops.size(), rhs.stops.size());
+  ASSERT_EQUAL(lhs.buses.size(), rhs.buses.size());
+
+  for (const Stop& lhs_stop : lhs.stops) {
+    const string& name = lhs.stop_names.GetName(lhs_stop.id);
+    const Stop& rhs_stop = rhs.stops.at(rhs.stop_names.GetId(name));
+    ASSERT_EQUAL(lhs_stop.position.latitude, rhs_stop.position.latitude);
+    ASSERT_EQUAL(lhs_stop.position.longitude, rhs_stop.position.longitude);
+    ASSERT_EQUAL(GetDistances(lhs, lhs_stop), GetDistances(rhs, rhs_stop));
+    ASSERT_EQUAL(GetPendingDistances(lhs_stop),
+                 GetPendingDistances(rhs_stop));
+  }
+
+  for (const Bus& lhs_bus : lhs.buses) {
+    const string& name = lhs.bus_names.GetName(lhs_bus.id);
+    const Bus& rhs_bus = rhs.buses.at(rhs.bus_names.GetId(name));
+    vector<string> lhs_stops;
+    for (const StopId stop_id : lhs_bus.stops) {
+      lhs_stops.push_back(lhs.stop_names.GetName(stop_id));
+    }
+    vector<string> rhs_stops;
+    for (const StopId stop_id : rhs_bus.stops) {
+      rhs_stops.push_back(rhs.stop_names.GetName(stop_id));
+    }
+    ASSERT_EQUAL(lhs_stops, rhs_stops);
+  }
+
+  ASSERT_EQUAL(GetRoadDistances(lhs), GetRoadDistances(rhs));
+}
+
+void TestUpdates() {
+  const Json::Document base = Json::Load(BASE_NODES);
+  const Json::Document extension = Json::Load(EXTENSION_NODES);
+  const Json::Document changes = Json::Load(CHANGE_NODES);
+
+  Input input = ReadDescriptions(base.GetRoot().AsArray());
+  ASSERT(IsExtension(input, extension.GetRoot().AsArray()));
+  ASSERT(!IsExtension(input, changes.GetRoot().AsArray()));
+
+  UpdateDescriptions(input, extension.GetRoot().AsArray());
+  const Stop& d = input.stops.at(input.stop_names.GetId("D"));
+  ASSERT_EQUAL(GetPendingDistances(d), (map<string, int>{{"E", 500}}));
+  // Given one way only
+  ASSERT_EQUAL(input.road_distances.Get(input.stop_names.GetId("A"), d.id),
+               700);
+
+  UpdateDescriptions(input, changes.GetRoot().AsArray());
+  // The rest keep their order, new names go last
+  ASSERT_EQUAL(GetNames(input.stop_names),
+               (vector<string>{"A", "B", "D", "E"}));
+  ASSERT_EQUAL(GetNames(input.bus_names), (vector<string>{"1", "3"}));
+  for (StopId id = 0; id < input.stops.size(); ++id) {
+    ASSERT_EQUAL(input.stops[id].id, id);
+  }
+  for (BusId id = 0; id < input.buses.size(); ++id) {
+    ASSERT_EQUAL(input.buses[id].id, id);
+  }
+  // Resolved once E is described, C is kept by name
+  const Stop& b = input.stops.at(input.stop_names.GetId("B"));
+  ASSERT_EQUAL(GetPendingDistances(b), (map<string, int>{{"C", 2000}}));
+  ASSERT_EQUAL(input.road_distances.Get(input.stop_names.GetId("E"),
+                                        input.stop_names.GetId("D")),
+               500);
+
+  const Json::Document combined = Json::Load(COMBINED_NODES);
+  AssertSameDescriptions(input,
+                         ReadDescriptions(combined.GetRoot().AsArray()));
+}
+
+void TestRemovalOfStopInUse() {
+  const Json::Document base = Json::Load(BASE_NODES);
+  const Json::Document removal = Json::Load(
+      R"([{"type": "Stop", "name": "B", "removed": true}])");
+
+  Input input = ReadDescriptions(base.GetRoot().AsArray());
+  ASSERT(!IsExtension(input, removal.GetRoot().AsArray()));
+  try {
+    UpdateDescriptions(input, removal.GetRoot().AsArray());
+    ASSERT(false);
+  } catch (const invalid_argument&) {
+  }
+}
+
+void RunTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestUpdates);
+  RUN_TEST(tr, TestRemovalOfStopInUse);
+}
+
+}  // namespace Descriptions
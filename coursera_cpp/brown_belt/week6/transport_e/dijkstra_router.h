@@ -0,0 +1,276 @@
+#pragma once
+
+#include "graph.h"
+#include "irouter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Graph {
+
+// Computes routes on demand with single-source Dijkstra instead of
+// precomputing all pairs. Shortest-path trees of queried sources are kept
+// in an LRU cache which never takes more than cache_budget_bytes.
+// The graph must be frozen, searches scan its packed incidence arrays.
+template <typename Weight>
+class DijkstraRouter : public IRouter<Weight> {
+ private:
+  using Graph = DirectedWeightedGraph<Weight>;
+
+ public:
+  static constexpr size_t DEFAULT_CACHE_BUDGET_BYTES = 256 << 20;
+
+  explicit DijkstraRouter(
+      const Graph& graph,
+      size_t cache_budget_bytes = DEFAULT_CACHE_BUDGET_BYTES);
+
+  using typename IRouter<Weight>::RouteInfo;
+
+  std::optional<Weight> WriteRoute(VertexId from,
+                                   VertexId to,
+                                   std::vector<EdgeId>& edges) const override;
+
+  // Runs one full search, its tree is not cached as matrices of routes
+  // would push out trees of ordinary requests
+  std::vector<std::optional<Weight>> ComputeRouteWeights(
+      VertexId from,
+      const std::vector<VertexId>& targets) const override;
+
+  // Nothing is precomputed
+  void Serialize(Serialization::Writer&) const override {}
+
+  // Of the trees cached at the moment
+  size_t ComputeMemoryUsage() const override;
+
+  // Drops cached trees which some new edge improves, the rest stay valid.
+  // Trees of the grown graph are larger, so fewer of them fit the budget,
+  // and the least recently used ones go as well.
+  bool AddEdges(EdgeId first_new_edge) override;
+
+ private:
+  static constexpr EdgeId NO_EDGE = std::numeric_limits<EdgeId>::max();
+
+  struct ShortestPathTree {
+    std::vector<Weight> weights;
+    std::vector<EdgeId> prev_edges;
+    std::vector<bool> reached;
+
+    // Trees cached before the graph grew don't know of new vertices
+    bool IsReached(VertexId vertex) const {
+      return vertex < reached.size() && reached[vertex];
+    }
+  };
+
+  // Stops as soon as stop_at is settled unless it is nullopt
+  ShortestPathTree ComputeTree(VertexId from,
+                               std::optional<VertexId> stop_at) const;
+
+  // Trees are shared, so one evicted while still in use stays alive
+  using TreeHolder = std::shared_ptr<const ShortestPathTree>;
+
+  TreeHolder GetCachedTree(VertexId from) const;
+
+  // How many trees of the graph as it is now fit the budget
+  size_t ComputeMaxCachedTrees() const;
+
+  const Graph& graph_;
+  size_t cache_budget_bytes_;
+  size_t max_cached_trees_;
+
+  using CachedTrees = std::list<std::pair<VertexId, TreeHolder>>;
+  mutable std::mutex cache_mutex_;
+  mutable CachedTrees cached_trees_;  // most recently used first
+  mutable std::unordered_map<VertexId, typename CachedTrees::iterator>
+      cached_tree_by_source_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph,
+                                       size_t cache_budget_bytes)
+    : graph_(graph), cache_budget_bytes_(cache_budget_bytes) {
+  assert(graph.IsFrozen());
+  max_cached_trees_ = ComputeMaxCachedTrees();
+}
+
+template <typename Weight>
+size_t DijkstraRouter<Weight>::ComputeMaxCachedTrees() const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  // Bits of reached take whole 64-bit words
+  const size_t tree_bytes =
+      vertex_count * (sizeof(Weight) + sizeof(EdgeId)) +
+      (vertex_count / 64 + 1) * sizeof(uint64_t);
+  return cache_budget_bytes_ / tree_bytes;
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::ShortestPathTree
+DijkstraRouter<Weight>::ComputeTree(VertexId from,
+                                    std::optional<VertexId> stop_at) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  ShortestPathTree tree{std::vector<Weight>(vertex_count),
+                        std::vector<EdgeId>(vertex_count, NO_EDGE),
+                        std::vector<bool>(vertex_count, false)};
+
+  using QueueItem = std::pair<Weight, VertexId>;
+  std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<>>
+      queue;
+  std::vector<bool> settled(vertex_count, false);
+
+  tree.weights[from] = 0;
+  tree.reached[from] = true;
+  queue.push({0, from});
+  while (!queue.empty()) {
+    const auto [weight, vertex] = queue.top();
+    queue.pop();
+    if (settled[vertex]) {
+      continue;
+    }
+    settled[vertex] = true;
+    if (stop_at && vertex == *stop_at) {
+      break;
+    }
+    const auto edge_ids = graph_.GetIncidentEdges(vertex).begin();
+    const VertexId* targets = graph_.GetIncidentTargets(vertex).begin();
+    const auto edge_weights = graph_.GetIncidentWeights(vertex);
+    const size_t edge_count = edge_weights.end() - edge_weights.begin();
+    for (size_t i = 0; i < edge_count; ++i) {
+      const VertexId to = targets[i];
+      const Weight edge_weight = edge_weights.begin()[i];
+      assert(edge_weight >= 0);
+      const Weight candidate_weight = weight + edge_weight;
+      if (!tree.reached[to] || candidate_weight < tree.weights[to]) {
+        tree.reached[to] = true;
+        tree.weights[to] = candidate_weight;
+        tree.prev_edges[to] = edge_ids[i];
+        queue.push({candidate_weight, to});
+      }
+    }
+  }
+
+  return tree;
+}
+
+template <typename Weight>
+typename DijkstraRouter<Weight>::TreeHolder
+DijkstraRouter<Weight>::GetCachedTree(VertexId from) const {
+  {
+    std::lock_guard<std::mutex> guard(cache_mutex_);
+    if (auto it = cached_tree_by_source_.find(from);
+        it != cached_tree_by_source_.end()) {
+      cached_trees_.splice(cached_trees_.begin(), cached_trees_, it->second);
+      return it->second->second;
+    }
+  }
+
+  // Computed without the lock: concurrent misses of the same source may
+  // do the work twice, but never wait for each other
+  auto tree = std::make_shared<const ShortestPathTree>(
+      ComputeTree(from, std::nullopt));
+
+  std::lock_guard<std::mutex> guard(cache_mutex_);
+  if (cached_tree_by_source_.count(from) > 0) {
+    return tree;
+  }
+  if (cached_trees_.size() == max_cached_trees_) {
+    cached_tree_by_source_.erase(cached_trees_.back().first);
+    cached_trees_.pop_back();
+  }
+  cached_trees_.emplace_front(from, tree);
+  cached_tree_by_source_[from] = cached_trees_.begin();
+  return tree;
+}
+
+template <typename Weight>
+std::optional<Weight> DijkstraRouter<Weight>::WriteRoute(
+    VertexId from,
+    VertexId to,
+    std::vector<EdgeId>& edges) const {
+  const TreeHolder tree_holder =
+      max_cached_trees_ == 0
+          ? std::make_shared<const ShortestPathTree>(ComputeTree(from, to))
+          : GetCachedTree(from);
+  const ShortestPathTree& tree = *tree_holder;
+  if (!tree.IsReached(to)) {
+    return std::nullopt;
+  }
+
+  edges.clear();
+  for (EdgeId edge_id = tree.prev_edges[to]; edge_id != NO_EDGE;
+       edge_id = tree.prev_edges[graph_.GetEdge(edge_id).from]) {
+    edges.push_back(edge_id);
+  }
+  std::reverse(std::begin(edges), std::end(edges));
+
+  return tree.weights[to];
+}
+
+template <typename Weight>
+size_t DijkstraRouter<Weight>::ComputeMemoryUsage() const {
+  std::lock_guard guard(cache_mutex_);
+  size_t bytes = 0;
+  for (const auto& [from, tree] : cached_trees_) {
+    bytes += GetCapacityBytes(tree->weights) +
+             GetCapacityBytes(tree->prev_edges) + tree->reached.capacity() / 8;
+  }
+  return bytes;
+}
+
+template <typename Weight>
+bool DijkstraRouter<Weight>::AddEdges(EdgeId first_new_edge) {
+  auto is_improved = [this, first_new_edge](const ShortestPathTree& tree) {
+    for (EdgeId edge_id = first_new_edge; edge_id < graph_.GetEdgeCount();
+         ++edge_id) {
+      const auto& edge = graph_.GetEdge(edge_id);
+      if (tree.IsReached(edge.from) &&
+          (!tree.IsReached(edge.to) ||
+           tree.weights[edge.from] + edge.weight < tree.weights[edge.to])) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  std::lock_guard<std::mutex> guard(cache_mutex_);
+  for (auto it = cached_trees_.begin(); it != cached_trees_.end();) {
+    if (is_improved(*it->second)) {
+      cached_tree_by_source_.erase(it->first);
+      it = cached_trees_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  max_cached_trees_ = ComputeMaxCachedTrees();
+  while (cached_trees_.size() > max_cached_trees_) {
+    cached_tree_by_source_.erase(cached_trees_.back().first);
+    cached_trees_.pop_back();
+  }
+  return true;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> DijkstraRouter<Weight>::ComputeRouteWeights(
+    VertexId from,
+    const std::vector<VertexId>& targets) const {
+  const ShortestPathTree tree = ComputeTree(from, std::nullopt);
+  std::vector<std::optional<Weight>> weights;
+  weights.reserve(targets.size());
+  for (const VertexId to : targets) {
+    weights.push_back(tree.reached[to] ? std::optional(tree.weights[to])
+                                       : std::nullopt);
+  }
+  return weights;
+}
+
+}  // namespace Graph
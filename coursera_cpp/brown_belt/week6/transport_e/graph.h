@@ -2,6 +2,7 @@
 
 #include "utils.h"
 
+#include <cassert>
 #include <cstdlib>
 #include <deque>
 #include <vector>
@@ -27,32 +28,105 @@ class DirectedWeightedGraph {
  public:
   DirectedWeightedGraph(size_t vertex_count = 0);
   EdgeId AddEdge(const Edge<Weight>& edge);
+  // Appends vertices without edges, returns the id of the first one
+  VertexId AddVertices(size_t count);
+  void ReserveEdges(size_t count) { edges_.reserve(count); }
+
+  // Packs incidence lists into contiguous arrays (CSR), together with ends
+  // and weights of edges. No edges may be added afterwards.
+  void Freeze();
+  bool IsFrozen() const { return !incidence_offsets_.empty(); }
+  // Unpacks incidence lists again, so that the graph can be extended
+  void Unfreeze();
 
   size_t GetVertexCount() const;
   size_t GetEdgeCount() const;
   const Edge<Weight>& GetEdge(EdgeId edge_id) const;
   IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
 
+  // Ends and weights of edges in the order of GetIncidentEdges, so that
+  // scans don't jump between edges. A frozen graph only.
+  Range<const VertexId*> GetIncidentTargets(VertexId vertex) const;
+  Range<const Weight*> GetIncidentWeights(VertexId vertex) const;
+
+  // Bytes of edges and incidence lists
+  size_t ComputeMemoryUsage() const;
+
  private:
+  size_t vertex_count_;
   std::vector<Edge<Weight>> edges_;
-  std::vector<IncidenceList> incidence_lists_;
+  std::vector<IncidenceList> incidence_lists_;  // until frozen
+  // Edges from vertex v take [incidence_offsets_[v], incidence_offsets_[v + 1])
+  // in the arrays below
+  std::vector<size_t> incidence_offsets_;
+  IncidenceList incident_edge_ids_;
+  std::vector<VertexId> incident_targets_;
+  std::vector<Weight> incident_weights_;
 };
 
 template <typename Weight>
 DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
-    : incidence_lists_(vertex_count) {}
+    : vertex_count_(vertex_count), incidence_lists_(vertex_count) {}
 
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+  assert(!IsFrozen());
   edges_.push_back(edge);
   const EdgeId id = edges_.size() - 1;
   incidence_lists_[edge.from].push_back(id);
   return id;
 }
 
+template <typename Weight>
+VertexId DirectedWeightedGraph<Weight>::AddVertices(size_t count) {
+  assert(!IsFrozen());
+  const VertexId first_vertex = vertex_count_;
+  vertex_count_ += count;
+  incidence_lists_.resize(vertex_count_);
+  return first_vertex;
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Freeze() {
+  if (IsFrozen()) {
+    return;
+  }
+  incidence_offsets_.reserve(vertex_count_ + 1);
+  incident_edge_ids_.reserve(edges_.size());
+  incident_targets_.reserve(edges_.size());
+  incident_weights_.reserve(edges_.size());
+  for (const auto& incidence_list : incidence_lists_) {
+    incidence_offsets_.push_back(incident_edge_ids_.size());
+    for (const EdgeId edge_id : incidence_list) {
+      incident_edge_ids_.push_back(edge_id);
+      incident_targets_.push_back(edges_[edge_id].to);
+      incident_weights_.push_back(edges_[edge_id].weight);
+    }
+  }
+  incidence_offsets_.push_back(incident_edge_ids_.size());
+  incidence_lists_.clear();
+  incidence_lists_.shrink_to_fit();
+}
+
+template <typename Weight>
+void DirectedWeightedGraph<Weight>::Unfreeze() {
+  if (!IsFrozen()) {
+    return;
+  }
+  incidence_lists_.resize(vertex_count_);
+  for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+    const auto edges = GetIncidentEdges(vertex);
+    incidence_lists_[vertex].assign(edges.begin(), edges.end());
+  }
+  incidence_offsets_.clear();
+  incident_edge_ids_.clear();
+  incident_targets_.clear();
+  incident_weights_.clear();
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-  return incidence_lists_.size();
+  return vertex_count_;
 }
 
 template <typename Weight>
@@ -60,6 +134,19 @@ size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
   return edges_.size();
 }
 
+template <typename Weight>
+size_t DirectedWeightedGraph<Weight>::ComputeMemoryUsage() const {
+  size_t bytes = GetCapacityBytes(edges_) + GetCapacityBytes(incidence_lists_) +
+                 GetCapacityBytes(incidence_offsets_) +
+                 GetCapacityBytes(incident_edge_ids_) +
+                 GetCapacityBytes(incident_targets_) +
+                 GetCapacityBytes(incident_weights_);
+  for (const auto& incidence_list : incidence_lists_) {
+    bytes += GetCapacityBytes(incidence_list);
+  }
+  return bytes;
+}
+
 template <typename Weight>
 const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(
     EdgeId edge_id) const {
@@ -69,7 +156,30 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
+  if (IsFrozen()) {
+    const auto begin = std::begin(incident_edge_ids_);
+    return {begin + incidence_offsets_[vertex],
+            begin + incidence_offsets_[vertex + 1]};
+  }
   const auto& edges = incidence_lists_[vertex];
   return {std::begin(edges), std::end(edges)};
 }
+
+template <typename Weight>
+Range<const VertexId*> DirectedWeightedGraph<Weight>::GetIncidentTargets(
+    VertexId vertex) const {
+  assert(IsFrozen());
+  const VertexId* data = incident_targets_.data();
+  return {data + incidence_offsets_[vertex],
+          data + incidence_offsets_[vertex + 1]};
+}
+
+template <typename Weight>
+Range<const Weight*> DirectedWeightedGraph<Weight>::GetIncidentWeights(
+    VertexId vertex) const {
+  assert(IsFrozen());
+  const Weight* data = incident_weights_.data();
+  return {data + incidence_offsets_[vertex],
+          data + incidence_offsets_[vertex + 1]};
+}
 }  // namespace Graph
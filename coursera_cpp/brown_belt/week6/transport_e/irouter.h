@@ -0,0 +1,58 @@
+#pragma once
+
+#include "graph.h"
+#include "serialization.h"
+
+#include <optional>
+#include <vector>
+
+namespace Graph {
+
+template <typename Weight>
+class IRouter {
+ public:
+  struct RouteInfo {
+    Weight weight;
+    std::vector<EdgeId> edges;
+  };
+
+  virtual ~IRouter() = default;
+
+  // Writes edges of the route into edges, reusing their memory, and returns
+  // its weight. Safe to call concurrently with distinct buffers.
+  virtual std::optional<Weight> WriteRoute(
+      VertexId from,
+      VertexId to,
+      std::vector<EdgeId>& edges) const = 0;
+
+  // Safe to call concurrently
+  std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const {
+    RouteInfo route;
+    const auto weight = WriteRoute(from, to, route.edges);
+    if (!weight) {
+      return std::nullopt;
+    }
+    route.weight = *weight;
+    return route;
+  }
+
+  // Weights of routes from one vertex to each of targets, nullopt where
+  // there is no route. Edges of routes are not built. Safe to call
+  // concurrently.
+  virtual std::vector<std::optional<Weight>> ComputeRouteWeights(
+      VertexId from,
+      const std::vector<VertexId>& targets) const = 0;
+
+  // Saves whatever was precomputed for answering queries
+  virtual void Serialize(Serialization::Writer& writer) const = 0;
+
+  // Bytes of what the router keeps for answering queries
+  virtual size_t ComputeMemoryUsage() const = 0;
+
+  // Catches up with edges appended to the graph from first_new_edge on,
+  // maybe along with new vertices. Returns false if the router can't, and
+  // has to be built anew. Not safe to call concurrently with queries.
+  virtual bool AddEdges(EdgeId) { return false; }
+};
+
+}  // namespace Graph
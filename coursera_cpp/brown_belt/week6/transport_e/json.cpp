@@ -1,102 +1,525 @@
 #include "json.h"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
 using namespace std;
 
 namespace Json {
 
-Node LoadArray(istream& input) {
-  vector<Node> result;
+// Enough for -1.2345678901234567e-308, the longest shortest form of a double,
+// and for any int64_t
+const size_t MAX_NUMBER_SIZE = 32;
+
+Dict::Dict(pmr::memory_resource* resource) : items_(resource) {}
+
+size_t Dict::size() const {
+  return items_.size();
+}
+
+bool IsKeyLess(const Dict::value_type& item, string_view key) {
+  return string_view(item.first) < key;
+}
+
+bool IsItemLess(const Dict::value_type& lhs, const Dict::value_type& rhs) {
+  return lhs.first < rhs.first;
+}
+
+bool AreKeysEqual(const Dict::value_type& lhs, const Dict::value_type& rhs) {
+  return lhs.first == rhs.first;
+}
+
+// A stable sort keeps equal keys in order, so unique leaves the first one
+Dict::Dict(pmr::vector<value_type> items) : items_(move(items)) {
+  stable_sort(items_.begin(), items_.end(), IsItemLess);
+  items_.erase(unique(items_.begin(), items_.end(), AreKeysEqual),
+               items_.end());
+}
+
+Dict::Dict(initializer_list<value_type> items)
+    : Dict(pmr::vector<value_type>(items)) {}
+
+// Small objects are searched linearly, which is faster for them
+const size_t MAX_LINEAR_SEARCH_SIZE = 8;
+
+Dict::const_iterator Dict::find(string_view key) const {
+  if (items_.size() <= MAX_LINEAR_SEARCH_SIZE) {
+    return find_if(items_.begin(), items_.end(),
+                   [key](const value_type& item) { return item.first == key; });
+  }
+  const auto it = lower_bound(items_.begin(), items_.end(), key, IsKeyLess);
+  return it != items_.end() && it->first == key ? it : items_.end();
+}
+
+size_t Dict::count(string_view key) const {
+  return find(key) != end();
+}
+
+const Node& Dict::at(string_view key) const {
+  const auto it = find(key);
+  if (it == end()) {
+    throw out_of_range("JSON: no key " + string(key));
+  }
+  return it->second;
+}
+
+pair<Dict::const_iterator, bool> Dict::emplace(key_type key, Node value) {
+  const auto it = lower_bound(items_.begin(), items_.end(), key, IsKeyLess);
+  if (it != items_.end() && it->first == key) {
+    return {it, false};
+  }
+  return {items_.emplace(it, move(key), move(value)), true};
+}
+
+void AppendUtf8(uint32_t code_point, string& output) {
+  if (code_point < 0x80) {
+    output += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    output += static_cast<char>(0xC0 | (code_point >> 6));
+    output += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000) {
+    output += static_cast<char>(0xE0 | (code_point >> 12));
+    output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    output += static_cast<char>(0x80 | (code_point & 0x3F));
+  } else {
+    output += static_cast<char>(0xF0 | (code_point >> 18));
+    output += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    output += static_cast<char>(0x80 | (code_point & 0x3F));
+  }
+}
+
+// The letter after the backslash in the short escape of c, 0 if it has none
+char GetShortEscape(char c) {
+  switch (c) {
+    case '"':
+      return '"';
+    case '\\':
+      return '\\';
+    case '\b':
+      return 'b';
+    case '\f':
+      return 'f';
+    case '\n':
+      return 'n';
+    case '\r':
+      return 'r';
+    case '\t':
+      return 't';
+    default:
+      return 0;
+  }
+}
 
-  for (char c; input >> c && c != ']';) {
-    if (c != ',') {
-      input.putback(c);
+// Quotes, backslashes and control characters are escaped, the rest of value,
+// UTF-8 included, goes as is
+void AppendQuoted(string_view value, string& output) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  output += '"';
+  // Runs of plain characters are appended at once
+  size_t run_begin = 0;
+  for (size_t pos = 0; pos < value.size(); ++pos) {
+    const unsigned char c = value[pos];
+    if (c >= 0x20 && c != '"' && c != '\\') {
+      continue;
+    }
+    output.append(value, run_begin, pos - run_begin);
+    run_begin = pos + 1;
+    output += '\\';
+    if (const char escape = GetShortEscape(c)) {
+      output += escape;
+    } else {
+      output += "u00";
+      output += HEX_DIGITS[c >> 4];
+      output += HEX_DIGITS[c & 0xF];
     }
-    result.push_back(LoadNode(input));
   }
+  output.append(value, run_begin, value.size() - run_begin);
+  output += '"';
+}
 
-  return Node(move(result));
+void Reader::BeginObject() {
+  ExpectChar('{');
+  is_after_begin_ = true;
 }
 
-Node LoadBool(istream& input) {
-  string s;
-  while (isalpha(input.peek())) {
-    s.push_back(input.get());
+optional<string_view> Reader::NextKey() {
+  if (!StartItem('}')) {
+    return nullopt;
   }
-  return Node(s == "true");
+  if (PeekChar() != '"') {
+    Fail("expected a key");
+  }
+  const string_view key = ReadString();
+  ExpectChar(':');
+  return key;
 }
 
-Node LoadNumber(istream& input) {
-  bool is_negative = false;
-  if (input.peek() == '-') {
-    is_negative = true;
-    input.get();
+void Reader::BeginArray() {
+  ExpectChar('[');
+  is_after_begin_ = true;
+}
+
+bool Reader::NextItem() {
+  return StartItem(']');
+}
+
+string_view Reader::ReadString() {
+  ExpectChar('"');
+  is_string_decoded_ = false;
+  const char* const string_begin = pos_;
+  while (pos_ != end_ && *pos_ != '"' && *pos_ != '\\') {
+    ++pos_;
   }
-  int int_part = 0;
-  while (isdigit(input.peek())) {
-    int_part *= 10;
-    int_part += input.get() - '0';
+  if (pos_ == end_) {
+    Fail("unterminated string");
   }
-  if (input.peek() != '.') {
-    return Node(int_part * (is_negative ? -1 : 1));
+  if (*pos_ == '"') {
+    return string_view(string_begin, pos_++ - string_begin);
   }
-  input.get();  // '.'
-  double result = int_part;
-  double frac_mult = 0.1;
-  while (isdigit(input.peek())) {
-    result += frac_mult * (input.get() - '0');
-    frac_mult /= 10;
+
+  is_string_decoded_ = true;
+  string& decoded = decoded_strings_.emplace_back(string_begin, pos_);
+  while (pos_ != end_ && *pos_ != '"') {
+    if (*pos_ != '\\') {
+      decoded += *pos_++;
+      continue;
+    }
+    if (++pos_ == end_) {
+      break;
+    }
+    switch (*pos_++) {
+      case '"':
+        decoded += '"';
+        break;
+      case '\\':
+        decoded += '\\';
+        break;
+      case '/':
+        decoded += '/';
+        break;
+      case 'b':
+        decoded += '\b';
+        break;
+      case 'f':
+        decoded += '\f';
+        break;
+      case 'n':
+        decoded += '\n';
+        break;
+      case 'r':
+        decoded += '\r';
+        break;
+      case 't':
+        decoded += '\t';
+        break;
+      case 'u':
+        AppendUtf8(ReadCodePoint(), decoded);
+        break;
+      default:
+        Fail("unknown escape");
+    }
   }
-  return Node(result * (is_negative ? -1 : 1));
+  if (pos_ == end_) {
+    Fail("unterminated string");
+  }
+  ++pos_;  // '"'
+  return decoded;
 }
 
-Node LoadString(istream& input) {
-  string line;
-  getline(input, line, '"');
-  return Node(move(line));
+int Reader::ReadInt() {
+  const Node number = ReadNumber();
+  if (!holds_alternative<int>(number.GetBase())) {
+    Fail("expected an int");
+  }
+  return number.AsInt();
 }
 
-Node LoadDict(istream& input) {
-  Dict result;
+double Reader::ReadDouble() {
+  return ReadNumber().AsDouble();
+}
 
-  for (char c; input >> c && c != '}';) {
-    if (c == ',') {
-      input >> c;
+bool Reader::ReadBool() {
+  PeekChar();
+  for (const string_view word : {"true"sv, "false"sv}) {
+    if (string_view(pos_, end_ - pos_).substr(0, word.size()) == word) {
+      pos_ += word.size();
+      return word == "true";
     }
+  }
+  Fail("expected true or false");
+}
 
-    string key = LoadString(input).AsString();
-    input >> c;
-    result.emplace(move(key), LoadNode(input));
+Node Reader::ReadNode() {
+  switch (PeekChar()) {
+    case '[': {
+      Array result(resource_);
+      BeginArray();
+      while (NextItem()) {
+        result.push_back(ReadNode());
+      }
+      return Node(move(result));
+    }
+    case '{': {
+      // Nested objects put their items after these and take them away
+      const size_t first_item = object_items_.size();
+      BeginObject();
+      while (const auto key = NextKey()) {
+        Dict::key_type owned_key(*key, resource_);
+        if (is_string_decoded_) {
+          decoded_strings_.pop_back();
+        }
+        Node value = ReadNode();
+        object_items_.emplace_back(move(owned_key), move(value));
+      }
+      const auto items_begin = object_items_.begin() + first_item;
+      pmr::vector<Dict::value_type> items(resource_);
+      items.reserve(object_items_.end() - items_begin);
+      move(items_begin, object_items_.end(), back_inserter(items));
+      object_items_.erase(items_begin, object_items_.end());
+      return Node(Dict(move(items)));
+    }
+    case '"': {
+      const string_view value = ReadString();
+      if (!is_string_decoded_) {
+        return Node(value);
+      }
+      // Goes next to the containers, so the node views it as it views text
+      char* const decoded =
+          static_cast<char*>(resource_->allocate(value.size(), alignof(char)));
+      copy(value.begin(), value.end(), decoded);
+      decoded_strings_.pop_back();
+      return Node(string_view(decoded, value.size()));
+    }
+    case 't':
+    case 'f':
+      return Node(ReadBool());
+    default:
+      return ReadNumber();
   }
+}
 
-  return Node(move(result));
+void Reader::SkipValue() {
+  switch (PeekChar()) {
+    case '[':
+      BeginArray();
+      while (NextItem()) {
+        SkipValue();
+      }
+      break;
+    case '{':
+      BeginObject();
+      while (NextKey()) {
+        SkipValue();
+      }
+      break;
+    case '"':
+      ReadString();
+      break;
+    case 't':
+    case 'f':
+      ReadBool();
+      break;
+    default:
+      ReadNumber();
+  }
 }
 
-Node LoadNode(istream& input) {
-  char c;
-  input >> c;
+void Reader::ExpectEnd() {
+  if (PeekChar() != '\0') {
+    Fail("unexpected text after the value");
+  }
+}
 
-  if (c == '[') {
-    return LoadArray(input);
-  } else if (c == '{') {
-    return LoadDict(input);
-  } else if (c == '"') {
-    return LoadString(input);
-  } else if (c == 't' || c == 'f') {
-    input.putback(c);
-    return LoadBool(input);
-  } else {
-    input.putback(c);
-    return LoadNumber(input);
+void Reader::Fail(const string& what) const {
+  throw invalid_argument("JSON: " + what + " at offset " +
+                         to_string(pos_ - begin_));
+}
+
+// Skips whitespace, '\0' at the end of the text
+char Reader::PeekChar() {
+  while (pos_ != end_ && isspace(static_cast<unsigned char>(*pos_))) {
+    ++pos_;
   }
+  return pos_ != end_ ? *pos_ : '\0';
+}
+
+bool Reader::SkipChar(char c) {
+  if (PeekChar() != c) {
+    return false;
+  }
+  ++pos_;
+  return true;
+}
+
+void Reader::ExpectChar(char c) {
+  if (!SkipChar(c)) {
+    Fail(string("expected '") + c + "'");
+  }
+}
+
+bool Reader::StartItem(char end) {
+  if (SkipChar(end)) {
+    is_after_begin_ = false;
+    return false;
+  }
+  if (!is_after_begin_) {
+    ExpectChar(',');
+  }
+  is_after_begin_ = false;
+  return true;
+}
+
+void Reader::SkipDigits() {
+  const char* const digits_begin = pos_;
+  while (pos_ != end_ && isdigit(static_cast<unsigned char>(*pos_))) {
+    ++pos_;
+  }
+  if (pos_ == digits_begin) {
+    Fail("expected a digit");
+  }
+}
+
+Node Reader::ReadNumber() {
+  PeekChar();
+  const char* const number_begin = pos_;
+  if (pos_ != end_ && *pos_ == '-') {
+    ++pos_;
+  }
+  if (pos_ == end_ || !isdigit(static_cast<unsigned char>(*pos_))) {
+    Fail("expected a value");
+  }
+  SkipDigits();
+  bool is_integer = true;
+  if (pos_ != end_ && *pos_ == '.') {
+    ++pos_;
+    SkipDigits();
+    is_integer = false;
+  }
+  if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+    ++pos_;
+    if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+      ++pos_;
+    }
+    SkipDigits();
+    is_integer = false;
+  }
+
+  if (is_integer) {
+    int64_t value;
+    // Integers beyond 64 bits are read as doubles
+    if (from_chars(number_begin, pos_, value).ec == errc{}) {
+      if (value >= numeric_limits<int>::min() &&
+          value <= numeric_limits<int>::max()) {
+        return Node(static_cast<int>(value));
+      }
+      return Node(value);
+    }
+  }
+  double value;
+  if (from_chars(number_begin, pos_, value).ec != errc{}) {
+    Fail("number out of range");
+  }
+  return Node(value);
+}
+
+uint32_t Reader::ReadHex4() {
+  if (end_ - pos_ < 4) {
+    Fail("expected 4 hex digits");
+  }
+  uint32_t value = 0;
+  for (const char* const hex_end = pos_ + 4; pos_ != hex_end; ++pos_) {
+    const char c = *pos_;
+    value <<= 4;
+    if (c >= '0' && c <= '9') {
+      value |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      value |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      value |= c - 'A' + 10;
+    } else {
+      Fail("expected 4 hex digits");
+    }
+  }
+  return value;
+}
+
+// Of a \u escape, where a UTF-16 surrogate pair takes two of them
+uint32_t Reader::ReadCodePoint() {
+  const uint32_t code_unit = ReadHex4();
+  if (code_unit < 0xD800 || code_unit > 0xDBFF) {
+    return code_unit;
+  }
+  if (end_ - pos_ < 2 || pos_[0] != '\\' || pos_[1] != 'u') {
+    Fail("expected a low surrogate");
+  }
+  pos_ += 2;
+  const uint32_t low_code_unit = ReadHex4();
+  if (low_code_unit < 0xDC00 || low_code_unit > 0xDFFF) {
+    Fail("expected a low surrogate");
+  }
+  return 0x10000 + ((code_unit - 0xD800) << 10) + (low_code_unit - 0xDC00);
+}
+
+Node LoadNode(string_view text, pmr::memory_resource* resource) {
+  Reader reader(text, resource);
+  Node root = reader.ReadNode();
+  reader.ExpectEnd();
+  return root;
+}
+
+Document::Document(vector<char> owned_text, string_view text)
+    : text_(move(owned_text)),
+      arena_(make_unique<pmr::monotonic_buffer_resource>()),
+      root_(LoadNode(text, arena_.get())) {}
+
+Document& Document::operator=(Document&& other) {
+  root_ = move(other.root_);
+  arena_ = move(other.arena_);
+  text_ = move(other.text_);
+  return *this;
+}
+
+Document Load(string_view text) {
+  return Document({}, text);
+}
+
+vector<char> ReadText(istream& input) {
+  const size_t CHUNK_SIZE = 1 << 20;
+  vector<char> text;
+  size_t size = 0;
+  do {
+    text.resize(size + CHUNK_SIZE);
+    input.read(text.data() + size, CHUNK_SIZE);
+    size += input.gcount();
+  } while (input);
+  text.resize(size);
+  return text;
 }
 
 Document Load(istream& input) {
-  return Document{LoadNode(input)};
+  vector<char> text = ReadText(input);
+  // The buffer of the vector stays in place when it is moved
+  const string_view text_view(text.data(), text.size());
+  return Document(move(text), text_view);
 }
 
 template <>
 void PrintValue<string>(const string& value, ostream& output) {
-  output << '"' << value << '"';
+  PrintValue(string_view(value), output);
+}
+
+template <>
+void PrintValue<string_view>(const string_view& value, ostream& output) {
+  string quoted;
+  AppendQuoted(value, quoted);
+  output << quoted;
 }
 
 template <>
@@ -105,8 +528,14 @@ void PrintValue<bool>(const bool& value, std::ostream& output) {
 }
 
 template <>
-void PrintValue<std::vector<Node>>(const std::vector<Node>& nodes,
-                                   std::ostream& output) {
+void PrintValue<double>(const double& value, std::ostream& output) {
+  char digits[MAX_NUMBER_SIZE];
+  const auto digits_end = to_chars(begin(digits), end(digits), value).ptr;
+  output.write(digits, digits_end - digits);
+}
+
+template <>
+void PrintValue<Array>(const Array& nodes, std::ostream& output) {
   output << '[';
   bool first = true;
   for (const Node& node : nodes) {
@@ -128,7 +557,7 @@ void PrintValue<Dict>(const Dict& dict, std::ostream& output) {
       output << ", ";
     }
     first = false;
-    PrintValue(key, output);
+    PrintValue(string_view(key), output);
     output << ": ";
     PrintNode(node, output);
   }
@@ -144,4 +573,106 @@ void Print(const Document& document, ostream& output) {
   PrintNode(document.GetRoot(), output);
 }
 
+Writer& Writer::BeginObject() {
+  StartItem();
+  buffer_ += '{';
+  is_after_item_ = false;
+  return *this;
+}
+
+Writer& Writer::EndObject() {
+  buffer_ += '}';
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::BeginArray() {
+  StartItem();
+  buffer_ += '[';
+  is_after_item_ = false;
+  return *this;
+}
+
+Writer& Writer::EndArray() {
+  buffer_ += ']';
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Key(string_view key) {
+  Value(key);
+  buffer_ += ": ";
+  is_after_item_ = false;
+  return *this;
+}
+
+Writer& Writer::Value(string_view value) {
+  StartItem();
+  AppendQuoted(value, buffer_);
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Value(int value) {
+  return Value(static_cast<int64_t>(value));
+}
+
+Writer& Writer::Value(int64_t value) {
+  StartItem();
+  char digits[MAX_NUMBER_SIZE];
+  buffer_.append(digits, to_chars(begin(digits), end(digits), value).ptr);
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Value(double value) {
+  StartItem();
+  char digits[MAX_NUMBER_SIZE];
+  buffer_.append(digits, to_chars(begin(digits), end(digits), value).ptr);
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Value(bool value) {
+  StartItem();
+  buffer_ += value ? "true" : "false";
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Null() {
+  StartItem();
+  buffer_ += "null";
+  FinishItem();
+  return *this;
+}
+
+Writer& Writer::Raw(string_view items) {
+  if (items.empty()) {
+    return *this;
+  }
+  StartItem();
+  buffer_ += items;
+  FinishItem();
+  return *this;
+}
+
+void Writer::Flush() {
+  output_.write(buffer_.data(), buffer_.size());
+  buffer_.clear();
+}
+
+void Writer::StartItem() {
+  if (is_after_item_) {
+    buffer_ += ", ";
+  }
+}
+
+void Writer::FinishItem() {
+  is_after_item_ = true;
+  if (buffer_.size() >= FLUSH_THRESHOLD) {
+    Flush();
+  }
+}
+
 }  // namespace Json
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -10,39 +16,176 @@
 namespace Json {
 
 class Node;
-using Dict = std::map<std::string, Node>;
+// Containers take their memory from a resource, which is the default heap
+// for nodes built in code and the arena of the document for parsed ones
+using Array = std::pmr::vector<Node>;
 
-class Node
-    : std::variant<std::vector<Node>, Dict, bool, int, double, std::string> {
+// Items of an object lie in one vector sorted by key, as most objects have
+// just a few keys. It is iterated in the order of keys as a map would be,
+// but items can't be changed in place.
+class Dict {
+ public:
+  using key_type = std::pmr::string;
+  using value_type = std::pair<key_type, Node>;
+  using const_iterator = std::pmr::vector<value_type>::const_iterator;
+  using iterator = const_iterator;
+
+  Dict() = default;
+  explicit Dict(std::pmr::memory_resource* resource);
+  // Items go in any order, and the first of equal keys is kept
+  explicit Dict(std::pmr::vector<value_type> items);
+  Dict(std::initializer_list<value_type> items);
+
+  const_iterator begin() const { return items_.begin(); }
+  const_iterator end() const { return items_.end(); }
+  bool empty() const { return items_.empty(); }
+  size_t size() const;
+
+  const_iterator find(std::string_view key) const;
+  size_t count(std::string_view key) const;
+  // Throws out_of_range if there is no key
+  const Node& at(std::string_view key) const;
+
+  // Leaves the dict as is if key is there already
+  std::pair<const_iterator, bool> emplace(key_type key, Node value);
+
+ private:
+  std::pmr::vector<value_type> items_;
+};
+
+// Strings of parsed nodes are views of their document, strings of nodes
+// built in code are owned by them. Parsed integers are int where they fit,
+// int64_t otherwise.
+class Node : std::variant<Array,
+                          Dict,
+                          bool,
+                          int,
+                          int64_t,
+                          double,
+                          std::string,
+                          std::string_view> {
  public:
   using variant::variant;
   const variant& GetBase() const { return *this; }
 
-  const auto& AsArray() const { return std::get<std::vector<Node>>(*this); }
+  const auto& AsArray() const { return std::get<Array>(*this); }
   const auto& AsMap() const { return std::get<Dict>(*this); }
   bool AsBool() const { return std::get<bool>(*this); }
   int AsInt() const { return std::get<int>(*this); }
+  int64_t AsInt64() const {
+    return std::holds_alternative<int>(*this) ? std::get<int>(*this)
+                                              : std::get<int64_t>(*this);
+  }
   double AsDouble() const {
     return std::holds_alternative<double>(*this) ? std::get<double>(*this)
-                                                 : std::get<int>(*this);
+                                                 : AsInt64();
+  }
+  std::string_view AsString() const {
+    return std::holds_alternative<std::string_view>(*this)
+               ? std::get<std::string_view>(*this)
+               : std::get<std::string>(*this);
   }
-  const auto& AsString() const { return std::get<std::string>(*this); }
 };
 
+// Nodes of a parsed document view its text and are allocated from its
+// arena, which takes memory in large blocks and frees them all at once.
+// The views stay valid while the document is moved, but not in its copies,
+// so it can't be copied.
 class Document {
  public:
-  explicit Document(Node root) : root(move(root)) {}
+  explicit Document(Node root) : root_(move(root)) {}
+  Document(Document&&) = default;
+  // Frees the old nodes before their arena and text
+  Document& operator=(Document&& other);
+  Document(const Document&) = delete;
+  Document& operator=(const Document&) = delete;
+
+  const Node& GetRoot() const { return root_; }
+
+ private:
+  friend Document Load(std::string_view text);
+  friend Document Load(std::istream& input);
+
+  // text is a view of owned_text if that isn't empty
+  Document(std::vector<char> owned_text, std::string_view text);
+
+  std::vector<char> text_;
+  // Goes after the nodes
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_;
+  Node root_;
+};
+
+// Pull parser: values are read one by one in the order of the text, and no
+// nodes are built unless asked for. Strings are views of the text, or of
+// decoded copies kept by the reader if they have escapes.
+// Throws invalid_argument where the text doesn't hold what is read.
+class Reader {
+ public:
+  // Containers and decoded strings of nodes read take memory from resource.
+  // The strings aren't given back, so it should be an arena.
+  Reader(std::string_view text, std::pmr::memory_resource* resource)
+      : begin_(text.data()),
+        pos_(text.data()),
+        end_(text.data() + text.size()),
+        resource_(resource) {}
+
+  void BeginObject();
+  // Of the next item, nullopt once the object ends
+  std::optional<std::string_view> NextKey();
 
-  const Node& GetRoot() const { return root; }
+  void BeginArray();
+  // False once the array ends
+  bool NextItem();
+
+  std::string_view ReadString();
+  int ReadInt();
+  // Of an int as well
+  double ReadDouble();
+  bool ReadBool();
+  // Strings with escapes are decoded into the resource and viewed there
+  Node ReadNode();
+  void SkipValue();
+
+  // Throws unless only whitespace is left
+  void ExpectEnd();
 
  private:
-  Node root;
+  [[noreturn]] void Fail(const std::string& what) const;
+  char PeekChar();
+  bool SkipChar(char c);
+  void ExpectChar(char c);
+  // At the next item of an object or an array, false at its end
+  bool StartItem(char end);
+
+  void SkipDigits();
+  Node ReadNumber();
+  uint32_t ReadHex4();
+  uint32_t ReadCodePoint();
+
+  const char* const begin_;
+  const char* pos_;
+  const char* const end_;
+  std::pmr::memory_resource* const resource_;
+  // No comma goes before the first item
+  bool is_after_begin_ = false;
+  // Elements of a deque stay in place
+  std::deque<std::string> decoded_strings_;
+  // Items of the objects being read, so each gets its dict at once
+  std::vector<Dict::value_type> object_items_;
+  bool is_string_decoded_ = false;
 };
 
-Node LoadNode(std::istream& input);
+// Strings without escapes are left in text and viewed by nodes, so text,
+// such as a mapped file, must outlive the document.
+// Throws invalid_argument if text is not a JSON value.
+Document Load(std::string_view text);
 
+// Reads the whole input into the document first
 Document Load(std::istream& input);
 
+// In large chunks, for a Reader over the whole input
+std::vector<char> ReadText(std::istream& input);
+
 void PrintNode(const Node& node, std::ostream& output);
 
 template <typename Value>
@@ -50,19 +193,67 @@ void PrintValue(const Value& value, std::ostream& output) {
   output << value;
 }
 
+// Strings are escaped the same way as by Writer
 template <>
 void PrintValue<std::string>(const std::string& value, std::ostream& output);
 
+template <>
+void PrintValue<std::string_view>(const std::string_view& value,
+                                  std::ostream& output);
+
 template <>
 void PrintValue<bool>(const bool& value, std::ostream& output);
 
+// The shortest form which reads back as the same value, whatever
+// the precision of output
 template <>
-void PrintValue<std::vector<Node>>(const std::vector<Node>& nodes,
-                                   std::ostream& output);
+void PrintValue<double>(const double& value, std::ostream& output);
+
+template <>
+void PrintValue<Array>(const Array& nodes, std::ostream& output);
 
 template <>
 void PrintValue<Dict>(const Dict& dict, std::ostream& output);
 
 void Print(const Document& document, std::ostream& output);
 
+// Writes JSON piece by piece into a buffer which goes to the output stream
+// once it grows large enough, so no Node tree is built for the output.
+// The layout is the same as PrintValue gives.
+class Writer {
+ public:
+  explicit Writer(std::ostream& output) : output_(output) {}
+  ~Writer() { Flush(); }
+
+  Writer& BeginObject();
+  Writer& EndObject();
+  Writer& BeginArray();
+  Writer& EndArray();
+  // Keys and string values are escaped where JSON requires it
+  Writer& Key(std::string_view key);
+
+  Writer& Value(std::string_view value);
+  Writer& Value(const char* value) { return Value(std::string_view(value)); }
+  Writer& Value(int value);
+  Writer& Value(int64_t value);
+  Writer& Value(double value);
+  Writer& Value(bool value);
+  Writer& Null();
+
+  // Writes items serialized by another writer, as if they came one by one
+  Writer& Raw(std::string_view items);
+
+  void Flush();
+
+ private:
+  static const size_t FLUSH_THRESHOLD = 1 << 16;
+
+  void StartItem();
+  void FinishItem();
+
+  std::ostream& output_;
+  std::string buffer_;
+  bool is_after_item_ = false;
+};
+
 }  // namespace Json
@@ -0,0 +1,168 @@
+#include "json_test.h"
+#include "json.h"
+#include "test_runner.h"
+
+#include <cstdint>
+#include <limits>
+#include <memory_resource>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+namespace Json {
+
+// With quotes, a backslash, control characters and a letter beyond ASCII
+const string_view ESCAPED_NAME = "Stop \"A\\B\"\n\t\x01 \xc3\xa9";
+
+// The same name escaped in an input object
+const string ESCAPED_NAME_JSON =
+    R"({"name": "Stop \"A\\B\"\n\t\u0001 \u00e9"})";
+
+void TestPrintEscapes() {
+  istringstream input(ESCAPED_NAME_JSON);
+  const Document document = Load(input);
+  ASSERT_EQUAL(document.GetRoot().AsMap().at("name").AsString(),
+               ESCAPED_NAME);
+
+  ostringstream output;
+  Print(document, output);
+  const string printed = output.str();
+  // Characters other than ASCII ones go as they are
+  ASSERT_EQUAL(printed, R"({"name": "Stop \"A\\B\"\n\t\u0001 )"
+                        "\xc3\xa9\"}");
+
+  istringstream printed_input(printed);
+  const Document reloaded = Load(printed_input);
+  ASSERT_EQUAL(reloaded.GetRoot().AsMap().at("name").AsString(),
+               ESCAPED_NAME);
+}
+
+void TestWriterEscapes() {
+  ostringstream output;
+  {
+    Writer writer(output);
+    writer.BeginObject();
+    writer.Key(ESCAPED_NAME).Value(ESCAPED_NAME);
+    writer.EndObject();
+  }
+
+  istringstream input(output.str());
+  const Document document = Load(input);
+  const Dict& dict = document.GetRoot().AsMap();
+  ASSERT_EQUAL(dict.size(), 1u);
+  ASSERT_EQUAL(dict.begin()->first, ESCAPED_NAME);
+  ASSERT_EQUAL(dict.begin()->second.AsString(), ESCAPED_NAME);
+}
+
+void TestNumberTypes() {
+  const Document document = Load(
+      "[0, -1, 2147483647, -2147483648, 2147483648, -2147483649, "
+      "9223372036854775807, -9223372036854775808, 9223372036854775808, "
+      "1.5, -0.25, 1e3, 2.5E-3, -1e+2, 0.0]");
+  const Array& nodes = document.GetRoot().AsArray();
+  ASSERT_EQUAL(nodes.size(), 15u);
+
+  for (size_t idx = 0; idx < 4; ++idx) {
+    ASSERT(holds_alternative<int>(nodes[idx].GetBase()));
+  }
+  ASSERT_EQUAL(nodes[0].AsInt(), 0);
+  ASSERT_EQUAL(nodes[1].AsInt(), -1);
+  ASSERT_EQUAL(nodes[2].AsInt(), numeric_limits<int>::max());
+  ASSERT_EQUAL(nodes[3].AsInt(), numeric_limits<int>::min());
+
+  for (size_t idx = 4; idx < 8; ++idx) {
+    ASSERT(holds_alternative<int64_t>(nodes[idx].GetBase()));
+  }
+  ASSERT_EQUAL(nodes[4].AsInt64(), int64_t{1} << 31);
+  ASSERT_EQUAL(nodes[5].AsInt64(), -(int64_t{1} << 31) - 1);
+  ASSERT_EQUAL(nodes[6].AsInt64(), numeric_limits<int64_t>::max());
+  ASSERT_EQUAL(nodes[7].AsInt64(), numeric_limits<int64_t>::min());
+  // Integers are doubles as well
+  ASSERT_EQUAL(nodes[2].AsDouble(), 2147483647.0);
+
+  // Beyond 64 bits, with a fraction or with an exponent
+  for (size_t idx = 8; idx < nodes.size(); ++idx) {
+    ASSERT(holds_alternative<double>(nodes[idx].GetBase()));
+  }
+  ASSERT_EQUAL(nodes[8].AsDouble(), 9223372036854775808.0);
+  ASSERT_EQUAL(nodes[9].AsDouble(), 1.5);
+  ASSERT_EQUAL(nodes[10].AsDouble(), -0.25);
+  ASSERT_EQUAL(nodes[11].AsDouble(), 1000.0);
+  ASSERT_EQUAL(nodes[12].AsDouble(), 0.0025);
+  ASSERT_EQUAL(nodes[13].AsDouble(), -100.0);
+  ASSERT_EQUAL(nodes[14].AsDouble(), 0.0);
+
+  pmr::monotonic_buffer_resource arena;
+  Reader reader("[7, 2e1, -3]", &arena);
+  reader.BeginArray();
+  ASSERT(reader.NextItem());
+  ASSERT_EQUAL(reader.ReadInt(), 7);
+  ASSERT(reader.NextItem());
+  ASSERT_EQUAL(reader.ReadDouble(), 20.0);
+  ASSERT(reader.NextItem());
+  ASSERT_EQUAL(reader.ReadDouble(), -3.0);
+  ASSERT(!reader.NextItem());
+
+  for (const string_view text : {"1e400", "-", "1.5.2", "01x"}) {
+    try {
+      Load(text);
+      ASSERT(false);
+    } catch (const invalid_argument&) {
+    }
+  }
+}
+
+// With fractions, exponents, the largest one and the smallest subnormal
+const vector<double> DOUBLES = {
+    0.1, 1.0 / 3, -2.5e-8, 1e21, 123456.789, 100.0, 1e-300,
+    1.7976931348623157e308, 5e-324,
+};
+
+void TestNumberRoundTrip() {
+  ostringstream output;
+  {
+    Writer writer(output);
+    writer.BeginArray();
+    for (const double value : DOUBLES) {
+      writer.Value(value);
+    }
+    writer.Value(numeric_limits<int64_t>::max());
+    writer.Value(numeric_limits<int64_t>::min());
+    writer.Value(numeric_limits<int>::min());
+    writer.EndArray();
+  }
+
+  const string written = output.str();
+  const Document document = Load(written);
+  const Array& nodes = document.GetRoot().AsArray();
+  ASSERT_EQUAL(nodes.size(), DOUBLES.size() + 3);
+  for (size_t idx = 0; idx < DOUBLES.size(); ++idx) {
+    ASSERT_EQUAL(nodes[idx].AsDouble(), DOUBLES[idx]);
+  }
+  ASSERT_EQUAL(nodes[DOUBLES.size()].AsInt64(),
+               numeric_limits<int64_t>::max());
+  ASSERT_EQUAL(nodes[DOUBLES.size() + 1].AsInt64(),
+               numeric_limits<int64_t>::min());
+  ASSERT_EQUAL(nodes[DOUBLES.size() + 2].AsInt(), numeric_limits<int>::min());
+
+  // Print gives the same digits, the shortest ones
+  ostringstream printed;
+  Print(document, printed);
+  ASSERT_EQUAL(printed.str(), written);
+  ASSERT_EQUAL(written.substr(0, 6), "[0.1, ");
+}
+
+void RunTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestPrintEscapes);
+  RUN_TEST(tr, TestWriterEscapes);
+  RUN_TEST(tr, TestNumberTypes);
+  RUN_TEST(tr, TestNumberRoundTrip);
+}
+
+}  // namespace Json
@@ -1,25 +1,207 @@
 #include "descriptions.h"
+#include "descriptions_test.h"
 #include "json.h"
+#include "json_test.h"
+#include "profiler.h"
 #include "requests.h"
+#include "route_cache_test.h"
+#include "router_test.h"
 #include "sphere.h"
+#include "stop_index_test.h"
 #include "transport_catalog.h"
+#include "transport_router_test.h"
 #include "utils.h"
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
 
 using namespace std;
 
-int main() {
-  const auto input_doc = Json::Load(cin);
-  const auto& input_map = input_doc.GetRoot().AsMap();
+// base_requests are read straight into descriptions unless they are
+// changes for update_base, the other parts are read into nodes allocated
+// from the given arena
+struct InputParts {
+  Json::Dict input_map;
+  Descriptions::Input descriptions;
+  Profiler::Clock::duration descriptions_time{};
+};
 
-  const TransportCatalog db(
-      Descriptions::ReadDescriptions(input_map.at("base_requests").AsArray()),
-      input_map.at("routing_settings").AsMap());
+InputParts ReadInput(string_view text,
+                     pmr::memory_resource* arena,
+                     bool are_descriptions_streamed) {
+  InputParts input{.input_map = Json::Dict(arena),
+                   .descriptions = {},
+                   .descriptions_time = {}};
+  Json::Reader reader(text, arena);
+  reader.BeginObject();
+  while (const auto key = reader.NextKey()) {
+    if (*key == "base_requests" && are_descriptions_streamed) {
+      const auto start = Profiler::Clock::now();
+      input.descriptions = Descriptions::ReadDescriptions(reader);
+      input.descriptions_time = Profiler::Clock::now() - start;
+    } else {
+      input.input_map.emplace(Json::Dict::key_type(*key, arena),
+                              reader.ReadNode());
+    }
+  }
+  reader.ExpectEnd();
+  return input;
+}
+
+const Json::Dict* GetExecutionSettings(const Json::Dict& input_map) {
+  const auto it = input_map.find("execution_settings");
+  return it != end(input_map) ? &it->second.AsMap() : nullptr;
+}
+
+size_t GetThreadCount(const Json::Dict& input_map) {
+  const auto* settings = GetExecutionSettings(input_map);
+  if (!settings || settings->count("thread_count") == 0) {
+    return 1;
+  }
+  return settings->at("thread_count").AsInt();
+}
+
+TransportCatalog BuildCatalog(Descriptions::Input descriptions,
+                              const Json::Dict& input_map) {
+  LOG_PHASE("build_catalog");
+  return TransportCatalog(move(descriptions),
+                          input_map.at("routing_settings").AsMap(),
+                          GetThreadCount(input_map));
+}
+
+bool IsProfiling(const Json::Dict& input_map) {
+  const auto* settings = GetExecutionSettings(input_map);
+  return settings && settings->count("profile") > 0 &&
+         settings->at("profile").AsBool();
+}
+
+void ReportMemoryUsage(const TransportCatalog& db) {
+  if (Profiler::IsEnabled()) {
+    db.ReportMemoryUsage();
+  }
+}
+
+// Sets what the catalog leaves to execution_settings
+void ApplyExecutionSettings(TransportCatalog& db, const Json::Dict& input_map) {
+  const auto* settings = GetExecutionSettings(input_map);
+  if (settings && settings->count("route_cache_mb") > 0) {
+    db.EnableRouteCache(
+        static_cast<size_t>(settings->at("route_cache_mb").AsInt()) << 20);
+  }
+}
+
+void ProcessRequests(TransportCatalog db, const Json::Dict& input_map) {
+  ApplyExecutionSettings(db, input_map);
+  {
+    LOG_PHASE("process_requests");
+    Requests::ProcessAll(db, input_map.at("stat_requests").AsArray(), cout,
+                         GetThreadCount(input_map));
+    cout << endl;
+  }
+  ReportMemoryUsage(db);
+}
+
+TransportCatalog LoadSnapshot(const string& file_name, size_t thread_count) {
+  LOG_PHASE("deserialize");
+  return TransportCatalog::Deserialize(file_name, thread_count);
+}
+
+void SaveSnapshot(const TransportCatalog& db, const string& file_name) {
+  LOG_PHASE("serialize");
+  ofstream snapshot(file_name, ios::binary);
+  db.Serialize(snapshot);
+}
+
+string GetSnapshotFileName(const Json::Dict& input_map) {
+  return string(
+      input_map.at("serialization_settings").AsMap().at("file").AsString());
+}
+
+// The old snapshot stays mapped while the updated one is written, so it goes
+// to another file which then replaces the old one
+void UpdateSnapshot(const string& file_name,
+                    const Json::Array& nodes,
+                    size_t thread_count) {
+  TransportCatalog db = LoadSnapshot(file_name, thread_count);
+  {
+    LOG_PHASE("update");
+    db.Update(nodes);
+  }
+  ReportMemoryUsage(db);
+
+  const string updated_file_name = file_name + ".updated";
+  SaveSnapshot(db, updated_file_name);
+  if (rename(updated_file_name.c_str(), file_name.c_str()) != 0) {
+    throw runtime_error("can't replace " + file_name);
+  }
+}
+
+// Without arguments builds the catalog and answers requests in one go.
+// make_base saves the built catalog to serialization_settings.file,
+// update_base applies base_requests to that file as changes,
+// process_requests answers stat_requests using that file, test runs unit
+// tests without reading the input.
+// With execution_settings.profile set, a JSON report of times and memory
+// goes to stderr. execution_settings.route_cache_mb enables caching routes
+// within that many megabytes. execution_settings.thread_count threads answer
+// requests and build routing tables where the router can use them.
+int main(int argc, const char* argv[]) {
+  const string_view mode = argc > 1 ? argv[1] : "";
+  if (mode == "test") {
+    Json::RunTests();
+    Descriptions::RunTests();
+    Graph::RunTests();
+    RunStopIndexTests();
+    RunRouteCacheTests();
+    RunTransportRouterTests();
+    return 0;
+  }
+
+  const auto parse_start = Profiler::Clock::now();
+  const vector<char> text = Json::ReadText(cin);
+  // Takes the memory of input nodes in large blocks, freed at once
+  pmr::monotonic_buffer_resource arena;
+  InputParts input = ReadInput(string_view(text.data(), text.size()), &arena,
+                               mode.empty() || mode == "make_base");
+  const Json::Dict& input_map = input.input_map;
+  if (IsProfiling(input_map)) {
+    Profiler::Enable();
+    Profiler::AddPhaseTime("parse_input", Profiler::Clock::now() -
+                                              parse_start -
+                                              input.descriptions_time);
+    Profiler::AddPhaseTime("read_descriptions", input.descriptions_time);
+  }
+
+  if (mode.empty()) {
+    ProcessRequests(BuildCatalog(move(input.descriptions), input_map),
+                    input_map);
+  } else if (mode == "make_base") {
+    const TransportCatalog db =
+        BuildCatalog(move(input.descriptions), input_map);
+    ReportMemoryUsage(db);
+    SaveSnapshot(db, GetSnapshotFileName(input_map));
+  } else if (mode == "update_base") {
+    UpdateSnapshot(GetSnapshotFileName(input_map),
+                   input_map.at("base_requests").AsArray(),
+                   GetThreadCount(input_map));
+  } else if (mode == "process_requests") {
+    ProcessRequests(LoadSnapshot(GetSnapshotFileName(input_map),
+                                 GetThreadCount(input_map)),
+                    input_map);
+  } else {
+    cerr << "Unknown mode " << mode << endl;
+    return 1;
+  }
 
-  Json::PrintValue(
-      Requests::ProcessAll(db, input_map.at("stat_requests").AsArray()), cout);
-  cout << endl;
+  if (Profiler::IsEnabled()) {
+    Profiler::WriteReport(cerr);
+    cerr << endl;
+  }
 
   return 0;
 }
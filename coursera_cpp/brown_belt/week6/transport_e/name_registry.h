@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Assigns dense ids to names in order of their first appearance.
+// Names are kept in a deque, so views of them used as keys stay valid
+// while the registry grows or is moved.
+class NameRegistry {
+ public:
+  using Id = uint32_t;
+
+  NameRegistry() = default;
+  NameRegistry(NameRegistry&&) = default;
+  NameRegistry& operator=(NameRegistry&&) = default;
+  NameRegistry(const NameRegistry&) = delete;
+  NameRegistry& operator=(const NameRegistry&) = delete;
+
+  Id Intern(std::string_view name) {
+    if (auto it = ids_.find(name); it != ids_.end()) {
+      return it->second;
+    }
+    const Id id = names_.size();
+    ids_.emplace(names_.emplace_back(name), id);
+    return id;
+  }
+
+  std::optional<Id> Find(std::string_view name) const {
+    if (auto it = ids_.find(name); it != ids_.end()) {
+      return it->second;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  Id GetId(std::string_view name) const {
+    if (auto id = Find(name)) {
+      return *id;
+    }
+    throw std::out_of_range("unknown name: " + std::string(name));
+  }
+
+  const std::string& GetName(Id id) const { return names_[id]; }
+
+  size_t GetSize() const { return names_.size(); }
+
+ private:
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, Id> ids_;
+};
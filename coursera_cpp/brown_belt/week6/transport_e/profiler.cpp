@@ -0,0 +1,164 @@
+#include "profiler.h"
+#include "json.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <optional>
+
+using namespace std;
+
+namespace Profiler {
+
+struct Container {
+  optional<size_t> count;
+  size_t bytes;
+};
+
+struct Report {
+  mutex data_mutex;
+  vector<pair<string, Clock::duration>> phase_times;
+  map<string, vector<Clock::duration>> request_latencies;
+  map<string, Container> containers;
+  map<string, uint64_t> counters;
+};
+
+bool is_enabled = false;
+
+Report& GetReport() {
+  static Report report;
+  return report;
+}
+
+void Enable() {
+  is_enabled = true;
+}
+
+bool IsEnabled() {
+  return is_enabled;
+}
+
+void AddPhaseTime(string_view phase, Clock::duration duration) {
+  Report& report = GetReport();
+  lock_guard guard(report.data_mutex);
+  auto& phase_times = report.phase_times;
+  const auto it = find_if(
+      begin(phase_times), end(phase_times),
+      [phase](const auto& phase_time) { return phase_time.first == phase; });
+  if (it != end(phase_times)) {
+    it->second += duration;
+  } else {
+    phase_times.emplace_back(phase, duration);
+  }
+}
+
+RequestLatencies::~RequestLatencies() {
+  if (latencies_.empty()) {
+    return;
+  }
+  Report& report = GetReport();
+  lock_guard guard(report.data_mutex);
+  for (auto& [type, latencies] : latencies_) {
+    auto& report_latencies = report.request_latencies[type];
+    report_latencies.insert(end(report_latencies), begin(latencies),
+                            end(latencies));
+  }
+}
+
+void RequestLatencies::Add(string_view type, Clock::duration latency) {
+  // There are few types, and a linear search builds no string per request
+  auto it = find_if(begin(latencies_), end(latencies_),
+                    [type](const auto& item) { return item.first == type; });
+  if (it == end(latencies_)) {
+    it = latencies_.emplace(type, vector<Clock::duration>{}).first;
+  }
+  it->second.push_back(latency);
+}
+
+void SetContainer(string_view name, optional<size_t> count, size_t bytes) {
+  Report& report = GetReport();
+  lock_guard guard(report.data_mutex);
+  report.containers[string(name)] = {count, bytes};
+}
+
+void AddContainer(string_view name, size_t count, size_t bytes) {
+  SetContainer(name, count, bytes);
+}
+
+void AddContainer(string_view name, size_t bytes) {
+  SetContainer(name, nullopt, bytes);
+}
+
+void AddCounter(string_view name, uint64_t value) {
+  Report& report = GetReport();
+  lock_guard guard(report.data_mutex);
+  report.counters[string(name)] = value;
+}
+
+double ToMilliseconds(Clock::duration duration) {
+  return chrono::duration<double, milli>(duration).count();
+}
+
+double ToMicroseconds(Clock::duration duration) {
+  return chrono::duration<double, micro>(duration).count();
+}
+
+// Nearest rank of sorted latencies
+Clock::duration GetPercentile(const vector<Clock::duration>& latencies,
+                              size_t percent) {
+  const size_t rank = (latencies.size() * percent + 99) / 100;
+  return latencies[max<size_t>(rank, 1) - 1];
+}
+
+void WriteReport(ostream& output) {
+  Report& report = GetReport();
+  lock_guard guard(report.data_mutex);
+  Json::Writer writer(output);
+  writer.BeginObject();
+
+  writer.Key("containers").BeginObject();
+  for (const auto& [name, container] : report.containers) {
+    writer.Key(name).BeginObject();
+    writer.Key("bytes").Value(static_cast<int64_t>(container.bytes));
+    if (container.count) {
+      writer.Key("count").Value(static_cast<int64_t>(*container.count));
+    }
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.Key("counters").BeginObject();
+  for (const auto& [name, value] : report.counters) {
+    writer.Key(name).Value(static_cast<int64_t>(value));
+  }
+  writer.EndObject();
+
+  writer.Key("phases").BeginArray();
+  for (const auto& [phase, duration] : report.phase_times) {
+    writer.BeginObject();
+    writer.Key("name").Value(phase);
+    writer.Key("time_ms").Value(ToMilliseconds(duration));
+    writer.EndObject();
+  }
+  writer.EndArray();
+
+  writer.Key("requests").BeginObject();
+  for (auto& [type, latencies] : report.request_latencies) {
+    sort(begin(latencies), end(latencies));
+    Clock::duration total_time{};
+    for (const auto latency : latencies) {
+      total_time += latency;
+    }
+    writer.Key(type).BeginObject();
+    writer.Key("count").Value(static_cast<int64_t>(latencies.size()));
+    writer.Key("p50_us").Value(ToMicroseconds(GetPercentile(latencies, 50)));
+    writer.Key("p99_us").Value(ToMicroseconds(GetPercentile(latencies, 99)));
+    writer.Key("time_ms").Value(ToMilliseconds(total_time));
+    writer.EndObject();
+  }
+  writer.EndObject();
+
+  writer.EndObject();
+}
+
+}  // namespace Profiler
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "profile.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Structured counterpart of LOG_DURATION: wall times of phases, latencies of
+// requests by type and sizes of major containers are collected into one
+// report written as JSON. Nothing is collected until Enable is called.
+namespace Profiler {
+using Clock = std::chrono::steady_clock;
+
+// To be called before any threads which report are started
+void Enable();
+bool IsEnabled();
+
+// Times of a phase entered more than once add up
+void AddPhaseTime(std::string_view phase, Clock::duration duration);
+
+class PhaseTimer {
+ public:
+  explicit PhaseTimer(std::string phase)
+      : phase_(std::move(phase)), start_(Clock::now()) {}
+
+  ~PhaseTimer() {
+    if (IsEnabled()) {
+      AddPhaseTime(phase_, Clock::now() - start_);
+    }
+  }
+
+ private:
+  std::string phase_;
+  Clock::time_point start_;
+};
+
+// Latencies of requests handled by one thread, handed over to the report at
+// once when destroyed, so threads don't contend for it per request
+class RequestLatencies {
+ public:
+  ~RequestLatencies();
+
+  void Add(std::string_view type, Clock::duration latency);
+
+ private:
+  std::unordered_map<std::string, std::vector<Clock::duration>> latencies_;
+};
+
+// Bytes are those of the container's own buffers and of buffers of its
+// items. The second form is for containers without a meaningful item count.
+void AddContainer(std::string_view name, size_t count, size_t bytes);
+void AddContainer(std::string_view name, size_t bytes);
+
+void AddCounter(std::string_view name, uint64_t value);
+
+// {"containers": {name: {"bytes", "count"}},
+//  "counters": {name: value},
+//  "phases": [{"name", "time_ms"}] in order of first exit, so nested
+//  phases go before the enclosing one,
+//  "requests": {type: {"count", "p50_us", "p99_us", "time_ms"}}}, where
+// count of a container is left out unless given
+void WriteReport(std::ostream& output);
+}  // namespace Profiler
+
+#define LOG_PHASE(phase) Profiler::PhaseTimer UNIQ_ID(__LINE__){phase};
@@ -0,0 +1,249 @@
+#include "raptor_router.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+const double INFINITE_TIME = numeric_limits<double>::infinity();
+
+struct RaptorRouter::Label {
+  double time = INFINITE_TIME;
+  uint32_t route_idx = NO_ROUTE;
+  uint32_t board_position = 0;
+  uint32_t alight_position = 0;
+};
+
+struct RaptorRouter::ScanState {
+  optional<Descriptions::StopId> target;
+  vector<double> best_times;  // over all rounds so far
+  vector<Descriptions::StopId> marked_stops;
+  vector<bool> is_marked;
+
+  ScanState(optional<Descriptions::StopId> target, size_t stop_count)
+      : target(target),
+        best_times(stop_count, INFINITE_TIME),
+        is_marked(stop_count, false) {}
+
+  double GetTimeBound(Descriptions::StopId stop_id) const {
+    return target ? min(best_times[stop_id], best_times[*target])
+                  : best_times[stop_id];
+  }
+};
+
+RaptorRouter::RaptorRouter(const vector<Descriptions::Stop>& stops,
+                           const vector<Descriptions::Bus>& buses,
+                           const Descriptions::RoadDistances& road_distances,
+                           int bus_wait_time,
+                           double bus_velocity)
+    : bus_wait_time_(bus_wait_time),
+      meters_per_minute_(bus_velocity * 1000.0 / 60),
+      stop_visit_offsets_(stops.size() + 1, 0) {
+  for (const auto& bus : buses) {
+    if (bus.stops.size() <= 1) {
+      continue;
+    }
+    routes_.push_back({bus.id, static_cast<uint32_t>(route_stops_.size()),
+                       static_cast<uint32_t>(bus.stops.size())});
+    int distance = 0;
+    for (size_t stop_idx = 0; stop_idx < bus.stops.size(); ++stop_idx) {
+      if (stop_idx > 0) {
+        distance += road_distances.Get(bus.stops[stop_idx - 1],
+                                       bus.stops[stop_idx]);
+      }
+      route_stops_.push_back(bus.stops[stop_idx]);
+      route_distances_.push_back(distance);
+      ++stop_visit_offsets_[bus.stops[stop_idx] + 1];
+    }
+  }
+
+  for (size_t stop_id = 0; stop_id < stops.size(); ++stop_id) {
+    stop_visit_offsets_[stop_id + 1] += stop_visit_offsets_[stop_id];
+  }
+  stop_visits_.resize(route_stops_.size());
+  vector<uint32_t> next_visit_idx(begin(stop_visit_offsets_),
+                                  prev(end(stop_visit_offsets_)));
+  for (uint32_t route_idx = 0; route_idx < routes_.size(); ++route_idx) {
+    const Route& route = routes_[route_idx];
+    for (uint32_t position = 0; position < route.stop_count; ++position) {
+      const auto stop_id = route_stops_[route.first_stop_idx + position];
+      stop_visits_[next_visit_idx[stop_id]++] = {route_idx, position};
+    }
+  }
+}
+
+template <typename T>
+vector<T> ReadVector(Serialization::Reader& reader) {
+  const auto items = reader.ReadArray<T>();
+  return {items.begin(), items.end()};
+}
+
+RaptorRouter::RaptorRouter(Serialization::Reader& reader)
+    : bus_wait_time_(reader.Read<double>()),
+      meters_per_minute_(reader.Read<double>()),
+      routes_(ReadVector<Route>(reader)),
+      route_stops_(ReadVector<Descriptions::StopId>(reader)),
+      route_distances_(ReadVector<int>(reader)),
+      stop_visit_offsets_(ReadVector<uint32_t>(reader)),
+      stop_visits_(ReadVector<RouteVisit>(reader)) {
+  if (stop_visit_offsets_.empty() ||
+      route_distances_.size() != route_stops_.size() ||
+      stop_visits_.size() != route_stops_.size()) {
+    throw runtime_error("routes of the snapshot are inconsistent");
+  }
+}
+
+void RaptorRouter::Serialize(Serialization::Writer& writer) const {
+  writer.Write(bus_wait_time_);
+  writer.Write(meters_per_minute_);
+  writer.WriteArray(routes_.data(), routes_.size());
+  writer.WriteArray(route_stops_.data(), route_stops_.size());
+  writer.WriteArray(route_distances_.data(), route_distances_.size());
+  writer.WriteArray(stop_visit_offsets_.data(), stop_visit_offsets_.size());
+  writer.WriteArray(stop_visits_.data(), stop_visits_.size());
+}
+
+size_t RaptorRouter::ComputeMemoryUsage() const {
+  return GetCapacityBytes(routes_) + GetCapacityBytes(route_stops_) +
+         GetCapacityBytes(route_distances_) +
+         GetCapacityBytes(stop_visit_offsets_) + GetCapacityBytes(stop_visits_);
+}
+
+double RaptorRouter::ComputeRideTime(const Route& route,
+                                     uint32_t from_position,
+                                     uint32_t to_position) const {
+  const int distance = route_distances_[route.first_stop_idx + to_position] -
+                       route_distances_[route.first_stop_idx + from_position];
+  return distance * 1.0 / meters_per_minute_;
+}
+
+void RaptorRouter::ScanRoute(uint32_t route_idx,
+                             uint32_t first_position,
+                             const Labels& previous_labels,
+                             Labels& labels,
+                             ScanState& state) const {
+  const Route& route = routes_[route_idx];
+  const auto* stops = &route_stops_[route.first_stop_idx];
+
+  bool is_boarded = false;
+  uint32_t board_position = 0;
+  double board_time = INFINITE_TIME;  // including the wait
+  for (uint32_t position = first_position; position < route.stop_count;
+       ++position) {
+    const auto stop_id = stops[position];
+    double time = INFINITE_TIME;
+    if (is_boarded) {
+      time = board_time + ComputeRideTime(route, board_position, position);
+      // Arriving later than the best time to the target is of no use
+      if (time < state.GetTimeBound(stop_id)) {
+        labels[stop_id] = {time, route_idx, board_position, position};
+        state.best_times[stop_id] = time;
+        if (!state.is_marked[stop_id]) {
+          state.is_marked[stop_id] = true;
+          state.marked_stops.push_back(stop_id);
+        }
+      }
+    }
+
+    // Boarding here may be better than staying on from an earlier stop
+    const double time_to_board =
+        previous_labels[stop_id].time + bus_wait_time_;
+    if (position + 1 < route.stop_count && time_to_board < INFINITE_TIME &&
+        (!is_boarded || time_to_board < time)) {
+      is_boarded = true;
+      board_position = position;
+      board_time = time_to_board;
+    }
+  }
+}
+
+vector<RaptorRouter::Labels> RaptorRouter::RunRounds(
+    Descriptions::StopId from,
+    ScanState& state) const {
+  state.best_times[from] = 0;
+  state.marked_stops = {from};
+
+  vector<Labels> rounds(1, Labels(GetStopCount()));
+  rounds[0][from].time = 0;
+
+  vector<uint32_t> first_positions(routes_.size(), NO_ROUTE);
+  vector<uint32_t> queued_routes;
+  while (!state.marked_stops.empty()) {
+    for (const auto stop_id : state.marked_stops) {
+      state.is_marked[stop_id] = false;
+      for (uint32_t visit_idx = stop_visit_offsets_[stop_id];
+           visit_idx < stop_visit_offsets_[stop_id + 1]; ++visit_idx) {
+        const RouteVisit& visit = stop_visits_[visit_idx];
+        uint32_t& first_position = first_positions[visit.route_idx];
+        if (first_position == NO_ROUTE) {
+          queued_routes.push_back(visit.route_idx);
+        }
+        first_position = min(first_position, visit.position);
+      }
+    }
+    state.marked_stops.clear();
+
+    rounds.push_back(rounds.back());
+    const Labels& previous_labels = rounds[rounds.size() - 2];
+    Labels& labels = rounds.back();
+    for (const uint32_t route_idx : queued_routes) {
+      ScanRoute(route_idx, first_positions[route_idx], previous_labels, labels,
+                state);
+      first_positions[route_idx] = NO_ROUTE;
+    }
+    queued_routes.clear();
+  }
+
+  return rounds;
+}
+
+optional<RaptorRouter::Journey> RaptorRouter::FindJourney(
+    Descriptions::StopId from,
+    Descriptions::StopId to) const {
+  ScanState state(to, GetStopCount());
+  const vector<Labels> rounds = RunRounds(from, state);
+
+  if (state.best_times[to] == INFINITE_TIME) {
+    return nullopt;
+  }
+
+  // Labels improved in a round hold the ride of that round, older ones were
+  // carried over unchanged
+  Journey journey{state.best_times[to], {}};
+  Descriptions::StopId stop_id = to;
+  for (size_t round = rounds.size() - 1; round > 0; --round) {
+    const Label& label = rounds[round][stop_id];
+    if (label.time == rounds[round - 1][stop_id].time) {
+      continue;
+    }
+    const Route& route = routes_[label.route_idx];
+    stop_id = route_stops_[route.first_stop_idx + label.board_position];
+    journey.legs.push_back({
+        .bus_id = route.bus_id,
+        .board_stop_id = stop_id,
+        .span_count = label.alight_position - label.board_position,
+        .ride_time = ComputeRideTime(route, label.board_position,
+                                     label.alight_position),
+    });
+  }
+  reverse(begin(journey.legs), end(journey.legs));
+
+  return journey;
+}
+
+vector<optional<double>> RaptorRouter::ComputeTotalTimes(
+    Descriptions::StopId from,
+    const vector<Descriptions::StopId>& targets) const {
+  ScanState state(nullopt, GetStopCount());
+  RunRounds(from, state);
+
+  vector<optional<double>> total_times;
+  total_times.reserve(targets.size());
+  for (const auto stop_id : targets) {
+    const double time = state.best_times[stop_id];
+    total_times.push_back(time < INFINITE_TIME ? optional(time) : nullopt);
+  }
+  return total_times;
+}
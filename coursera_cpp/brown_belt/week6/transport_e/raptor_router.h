@@ -0,0 +1,97 @@
+#pragma once
+
+#include "descriptions.h"
+#include "serialization.h"
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Round-based routing (RAPTOR) straight over bus routes, without a graph.
+// Round k finds the best times to reach stops with k rides by scanning each
+// route from the first of its stops improved in round k - 1. Routes and
+// stops are kept in flat arrays, so every scan walks contiguous memory.
+class RaptorRouter {
+ public:
+  RaptorRouter(const std::vector<Descriptions::Stop>& stops,
+               const std::vector<Descriptions::Bus>& buses,
+               const Descriptions::RoadDistances& road_distances,
+               int bus_wait_time,
+               double bus_velocity);
+  explicit RaptorRouter(Serialization::Reader& reader);
+
+  void Serialize(Serialization::Writer& writer) const;
+
+  size_t ComputeMemoryUsage() const;
+
+  struct Leg {
+    Descriptions::BusId bus_id;
+    Descriptions::StopId board_stop_id;
+    size_t span_count;
+    double ride_time;
+  };
+
+  struct Journey {
+    double total_time;
+    std::vector<Leg> legs;
+  };
+
+  // Safe to call concurrently
+  std::optional<Journey> FindJourney(Descriptions::StopId from,
+                                     Descriptions::StopId to) const;
+
+  // Best times from one stop to each of targets after a single run without
+  // pruning, nullopt for unreachable ones
+  std::vector<std::optional<double>> ComputeTotalTimes(
+      Descriptions::StopId from,
+      const std::vector<Descriptions::StopId>& targets) const;
+
+  double GetWaitTime() const { return bus_wait_time_; }
+
+ private:
+  static constexpr uint32_t NO_ROUTE = UINT32_MAX;
+
+  struct Route {
+    Descriptions::BusId bus_id;
+    uint32_t first_stop_idx;  // in route_stops_ and route_distances_
+    uint32_t stop_count;
+  };
+
+  struct RouteVisit {
+    uint32_t route_idx;
+    uint32_t position;
+  };
+
+  // Best time to reach a stop within some number of rides and the ride
+  // which gave it
+  struct Label;
+  using Labels = std::vector<Label>;
+
+  struct ScanState;
+
+  // Runs rounds until no stop improves, returns labels of every round.
+  // Arrivals later than the best time to the target are dropped, if any.
+  std::vector<Labels> RunRounds(Descriptions::StopId from,
+                                ScanState& state) const;
+
+  void ScanRoute(uint32_t route_idx,
+                 uint32_t first_position,
+                 const Labels& previous_labels,
+                 Labels& labels,
+                 ScanState& state) const;
+
+  double ComputeRideTime(const Route& route,
+                         uint32_t from_position,
+                         uint32_t to_position) const;
+
+  size_t GetStopCount() const { return stop_visit_offsets_.size() - 1; }
+
+  double bus_wait_time_;
+  double meters_per_minute_;
+  std::vector<Route> routes_;
+  std::vector<Descriptions::StopId> route_stops_;
+  std::vector<int> route_distances_;  // from the first stop of the route
+  // Visits of stop s are stop_visits_[stop_visit_offsets_[s]..[s + 1])
+  std::vector<uint32_t> stop_visit_offsets_;
+  std::vector<RouteVisit> stop_visits_;
+};
@@ -1,107 +1,268 @@
 #include "requests.h"
+#include "profiler.h"
 #include "transport_router.h"
 
+#include <algorithm>
+#include <future>
+#include <sstream>
+#include <string_view>
 #include <vector>
 
 using namespace std;
 
 namespace Requests {
 
-Json::Dict Stop::Process(const TransportCatalog& db) const {
+void WriteNotFound(int request_id, Json::Writer& writer) {
+  writer.Key("error_message").Value("not found");
+  writer.Key("request_id").Value(request_id);
+}
+
+void Stop::Process(const TransportCatalog& db,
+                   int request_id,
+                   Json::Writer& writer) const {
   const auto* stop = db.GetStop(name);
-  Json::Dict dict;
+  writer.BeginObject();
   if (!stop) {
-    dict["error_message"] = Json::Node("not found"s);
+    WriteNotFound(request_id, writer);
   } else {
-    vector<Json::Node> bus_nodes;
-    bus_nodes.reserve(stop->bus_names.size());
-    for (const auto& bus_name : stop->bus_names) {
-      bus_nodes.emplace_back(bus_name);
+    writer.Key("buses").BeginArray();
+    for (const auto bus_id : stop->bus_ids) {
+      writer.Value(db.GetBusName(bus_id));
     }
-    dict["buses"] = Json::Node(move(bus_nodes));
+    writer.EndArray();
+    writer.Key("request_id").Value(request_id);
   }
-  return dict;
+  writer.EndObject();
 }
 
-Json::Dict Bus::Process(const TransportCatalog& db) const {
+void Bus::Process(const TransportCatalog& db,
+                  int request_id,
+                  Json::Writer& writer) const {
   const auto* bus = db.GetBus(name);
-  Json::Dict dict;
+  writer.BeginObject();
   if (!bus) {
-    dict["error_message"] = Json::Node("not found"s);
+    WriteNotFound(request_id, writer);
   } else {
-    dict = {
-        {"stop_count", Json::Node(static_cast<int>(bus->stop_count))},
-        {"unique_stop_count",
-         Json::Node(static_cast<int>(bus->unique_stop_count))},
-        {"route_length", Json::Node(bus->road_route_length)},
-        {"curvature",
-         Json::Node(bus->road_route_length / bus->geo_route_length)},
-    };
+    writer.Key("curvature").Value(bus->road_route_length /
+                                  bus->geo_route_length);
+    writer.Key("request_id").Value(request_id);
+    writer.Key("route_length").Value(bus->road_route_length);
+    writer.Key("stop_count").Value(static_cast<int>(bus->stop_count));
+    writer.Key("unique_stop_count")
+        .Value(static_cast<int>(bus->unique_stop_count));
   }
-  return dict;
+  writer.EndObject();
 }
 
-struct RouteItemResponseBuilder {
-  Json::Dict operator()(
-      const TransportRouter::RouteInfo::BusItem& bus_item) const {
-    return Json::Dict{
-        {"type", Json::Node("Bus"s)},
-        {"bus", Json::Node(bus_item.bus_name)},
-        {"time", Json::Node(bus_item.time)},
-        {"span_count", Json::Node(static_cast<int>(bus_item.span_count))}};
+struct RouteItemResponseWriter {
+  const TransportCatalog& db;
+  Json::Writer& writer;
+
+  void operator()(const TransportRouter::RouteInfo::BusItem& bus_item) const {
+    writer.BeginObject();
+    writer.Key("bus").Value(db.GetBusName(bus_item.bus_id));
+    writer.Key("span_count").Value(static_cast<int>(bus_item.span_count));
+    writer.Key("time").Value(bus_item.time);
+    writer.Key("type").Value("Bus");
+    writer.EndObject();
   }
-  Json::Dict operator()(
-      const TransportRouter::RouteInfo::WaitItem& wait_item) const {
-    return Json::Dict{
-        {"type", Json::Node("Wait"s)},
-        {"stop_name", Json::Node(wait_item.stop_name)},
-        {"time", Json::Node(wait_item.time)},
-    };
+  void operator()(const TransportRouter::RouteInfo::WaitItem& wait_item) const {
+    writer.BeginObject();
+    writer.Key("stop_name").Value(db.GetStopName(wait_item.stop_id));
+    writer.Key("time").Value(wait_item.time);
+    writer.Key("type").Value("Wait");
+    writer.EndObject();
   }
 };
 
-Json::Dict Route::Process(const TransportCatalog& db) const {
-  Json::Dict dict;
+void Route::Process(const TransportCatalog& db,
+                    int request_id,
+                    Json::Writer& writer) const {
   const auto route = db.FindRoute(stop_from, stop_to);
+  writer.BeginObject();
   if (!route) {
-    dict["error_message"] = Json::Node("not found"s);
+    WriteNotFound(request_id, writer);
   } else {
-    dict["total_time"] = Json::Node(route->total_time);
-    vector<Json::Node> items;
-    items.reserve(route->items.size());
+    writer.Key("items").BeginArray();
     for (const auto& item : route->items) {
-      items.push_back(visit(RouteItemResponseBuilder{}, item));
+      visit(RouteItemResponseWriter{db, writer}, item);
+    }
+    writer.EndArray();
+    writer.Key("request_id").Value(request_id);
+    writer.Key("total_time").Value(route->total_time);
+  }
+  writer.EndObject();
+}
+
+void RouteMatrix::Process(const TransportCatalog& db,
+                          int request_id,
+                          Json::Writer& writer,
+                          size_t thread_count) const {
+  const auto matrix =
+      db.ComputeRouteMatrix(stops_from, stops_to, thread_count);
+  writer.BeginObject();
+  if (!matrix) {
+    WriteNotFound(request_id, writer);
+  } else {
+    writer.Key("request_id").Value(request_id);
+    writer.Key("total_times").BeginArray();
+    for (const auto& row : *matrix) {
+      writer.BeginArray();
+      for (const auto& total_time : row) {
+        if (total_time) {
+          writer.Value(*total_time);
+        } else {
+          writer.Null();
+        }
+      }
+      writer.EndArray();
     }
+    writer.EndArray();
+  }
+  writer.EndObject();
+}
 
-    dict["items"] = move(items);
+void WriteNeighbors(const TransportCatalog& db,
+                    int request_id,
+                    const vector<StopIndex::Neighbor>& neighbors,
+                    Json::Writer& writer) {
+  writer.BeginObject();
+  writer.Key("request_id").Value(request_id);
+  writer.Key("stops").BeginArray();
+  for (const auto& neighbor : neighbors) {
+    writer.BeginObject();
+    writer.Key("distance").Value(neighbor.distance);
+    writer.Key("stop_name").Value(db.GetStopName(neighbor.stop_id));
+    writer.EndObject();
   }
+  writer.EndArray();
+  writer.EndObject();
+}
+
+void NearestStops::Process(const TransportCatalog& db,
+                           int request_id,
+                           Json::Writer& writer) const {
+  WriteNeighbors(db, request_id, db.FindNearestStops(point, count), writer);
+}
+
+void StopsInRadius::Process(const TransportCatalog& db,
+                            int request_id,
+                            Json::Writer& writer) const {
+  WriteNeighbors(db, request_id, db.FindStopsInRadius(point, radius), writer);
+}
 
-  return dict;
+vector<string> ReadStopNames(const Json::Node& node) {
+  vector<string> names;
+  names.reserve(node.AsArray().size());
+  for (const Json::Node& name_node : node.AsArray()) {
+    names.emplace_back(name_node.AsString());
+  }
+  return names;
 }
 
-variant<Stop, Bus, Route> Read(const Json::Dict& attrs) {
-  const string& type = attrs.at("type").AsString();
+Sphere::Point ReadPoint(const Json::Dict& attrs) {
+  return {.latitude = attrs.at("latitude").AsDouble(),
+          .longitude = attrs.at("longitude").AsDouble()};
+}
+
+variant<Stop, Bus, Route, RouteMatrix, NearestStops, StopsInRadius> Read(
+    const Json::Dict& attrs) {
+  const string_view type = attrs.at("type").AsString();
   if (type == "Bus") {
-    return Bus{attrs.at("name").AsString()};
+    return Bus{string(attrs.at("name").AsString())};
   } else if (type == "Stop") {
-    return Stop{attrs.at("name").AsString()};
+    return Stop{string(attrs.at("name").AsString())};
+  } else if (type == "RouteMatrix") {
+    return RouteMatrix{ReadStopNames(attrs.at("from")),
+                       ReadStopNames(attrs.at("to"))};
+  } else if (type == "NearestStops") {
+    return NearestStops{ReadPoint(attrs),
+                        static_cast<size_t>(attrs.at("count").AsInt())};
+  } else if (type == "StopsInRadius") {
+    return StopsInRadius{ReadPoint(attrs), attrs.at("radius").AsDouble()};
   } else {
-    return Route{attrs.at("from").AsString(), attrs.at("to").AsString()};
+    return Route{string(attrs.at("from").AsString()),
+                 string(attrs.at("to").AsString())};
   }
 }
 
-vector<Json::Node> ProcessAll(const TransportCatalog& db,
-                              const vector<Json::Node>& requests) {
-  vector<Json::Node> responses;
-  responses.reserve(requests.size());
+// Only RouteMatrix requests take more than one thread
+struct RequestProcessor {
+  const TransportCatalog& db;
+  int request_id;
+  Json::Writer& writer;
+  size_t thread_count;
+
+  template <typename Request>
+  void operator()(const Request& request) const {
+    request.Process(db, request_id, writer);
+  }
+  void operator()(const RouteMatrix& request) const {
+    request.Process(db, request_id, writer, thread_count);
+  }
+};
+
+using RequestsRange = Range<Json::Array::const_iterator>;
+
+void ProcessRange(const TransportCatalog& db,
+                  RequestsRange requests,
+                  Json::Writer& writer,
+                  size_t thread_count) {
+  const bool is_profiling = Profiler::IsEnabled();
+  Profiler::RequestLatencies latencies;
   for (const Json::Node& request_node : requests) {
-    Json::Dict dict =
-        visit([&db](const auto& request) { return request.Process(db); },
-              Requests::Read(request_node.AsMap()));
-    dict["request_id"] = Json::Node(request_node.AsMap().at("id").AsInt());
-    responses.push_back(Json::Node(dict));
+    const auto start =
+        is_profiling ? Profiler::Clock::now() : Profiler::Clock::time_point{};
+    const auto& request_dict = request_node.AsMap();
+    const int request_id = request_dict.at("id").AsInt();
+    visit(RequestProcessor{db, request_id, writer, thread_count},
+          Requests::Read(request_dict));
+    if (is_profiling) {
+      latencies.Add(request_dict.at("type").AsString(),
+                    Profiler::Clock::now() - start);
+    }
+  }
+}
+
+// Requests handled by one thread at a time, bounds the memory which holds
+// responses until they can be written in order
+const size_t CHUNK_SIZE = 1024;
+
+void ProcessAll(const TransportCatalog& db,
+                const Json::Array& requests,
+                ostream& output,
+                size_t thread_count) {
+  Json::Writer writer(output);
+  writer.BeginArray();
+  if (thread_count <= 1 || requests.size() <= CHUNK_SIZE) {
+    ProcessRange(db, AsRange(requests), writer, thread_count);
+  } else {
+    for (size_t batch_begin = 0; batch_begin < requests.size();
+         batch_begin += thread_count * CHUNK_SIZE) {
+      vector<future<string>> futures;
+      for (size_t chunk_begin = batch_begin;
+           chunk_begin < min(batch_begin + thread_count * CHUNK_SIZE,
+                             requests.size());
+           chunk_begin += CHUNK_SIZE) {
+        const size_t chunk_end = min(chunk_begin + CHUNK_SIZE, requests.size());
+        const RequestsRange chunk{begin(requests) + chunk_begin,
+                                  begin(requests) + chunk_end};
+        futures.push_back(async(launch::async, [&db, chunk] {
+          ostringstream chunk_output;
+          {
+            Json::Writer chunk_writer(chunk_output);
+            // Chunks take all the threads already
+            ProcessRange(db, chunk, chunk_writer, 1);
+          }
+          return chunk_output.str();
+        }));
+      }
+      for (auto& future : futures) {
+        writer.Raw(future.get());
+      }
+    }
   }
-  return responses;
+  writer.EndArray();
 }
 
 }  // namespace Requests
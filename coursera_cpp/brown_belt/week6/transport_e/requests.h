@@ -1,33 +1,84 @@
 #pragma once
 
 #include "json.h"
+#include "sphere.h"
 #include "transport_catalog.h"
 
+#include <ostream>
 #include <string>
 #include <variant>
+#include <vector>
 
+// Responses are written straight into Json::Writer. Keys go in alphabetical
+// order, the same as when responses were built as Json::Dict.
 namespace Requests {
 struct Stop {
   std::string name;
 
-  Json::Dict Process(const TransportCatalog& db) const;
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer) const;
 };
 
 struct Bus {
   std::string name;
 
-  Json::Dict Process(const TransportCatalog& db) const;
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer) const;
 };
 
 struct Route {
   std::string stop_from;
   std::string stop_to;
 
-  Json::Dict Process(const TransportCatalog& db) const;
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer) const;
 };
 
-std::variant<Stop, Bus, Route> Read(const Json::Dict& attrs);
+// Total times only, for every pair of a stop from "from" and one from "to"
+struct RouteMatrix {
+  std::vector<std::string> stops_from;
+  std::vector<std::string> stops_to;
 
-std::vector<Json::Node> ProcessAll(const TransportCatalog& db,
-                                   const std::vector<Json::Node>& requests);
+  // Rows are computed on thread_count threads
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer,
+               size_t thread_count = 1) const;
+};
+
+// Stops closest to a point, nearest first
+struct NearestStops {
+  Sphere::Point point;
+  size_t count;
+
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer) const;
+};
+
+// Stops within radius meters of a point, nearest first
+struct StopsInRadius {
+  Sphere::Point point;
+  double radius;
+
+  void Process(const TransportCatalog& db,
+               int request_id,
+               Json::Writer& writer) const;
+};
+
+std::variant<Stop, Bus, Route, RouteMatrix, NearestStops, StopsInRadius> Read(
+    const Json::Dict& attrs);
+
+// Writes the array of responses to output. With several threads requests
+// are split into chunks processed concurrently, a batch of chunks at a time,
+// and responses keep the order of requests. Requests which fit into one chunk
+// are processed on the calling thread, and RouteMatrix spreads its rows over
+// the threads instead.
+void ProcessAll(const TransportCatalog& db,
+                const Json::Array& requests,
+                std::ostream& output,
+                size_t thread_count = 1);
 }  // namespace Requests
@@ -0,0 +1,81 @@
+#include "route_cache.h"
+#include "utils.h"
+
+using namespace std;
+
+RouteCache::RouteCache(size_t budget_bytes)
+    : shard_budget_bytes_(budget_bytes / SHARD_COUNT) {}
+
+optional<RouteCache::RouteHolder> RouteCache::Find(Descriptions::StopId from,
+                                                   Descriptions::StopId to) {
+  const Key key = MakeKey(from, to);
+  Shard& shard = GetShard(key);
+  lock_guard guard(shard.mutex);
+  const auto it = shard.entry_by_key.find(key);
+  if (it == end(shard.entry_by_key)) {
+    ++shard.miss_count;
+    return nullopt;
+  }
+  ++shard.hit_count;
+  shard.entries.splice(begin(shard.entries), shard.entries, it->second);
+  return it->second->second;
+}
+
+void RouteCache::Add(Descriptions::StopId from,
+                     Descriptions::StopId to,
+                     RouteHolder route) {
+  const Key key = MakeKey(from, to);
+  const size_t entry_bytes = ComputeEntryBytes(route);
+  if (entry_bytes > shard_budget_bytes_) {
+    return;
+  }
+
+  Shard& shard = GetShard(key);
+  lock_guard guard(shard.mutex);
+  // Another thread may have found the same route meanwhile
+  if (shard.entry_by_key.count(key) > 0) {
+    return;
+  }
+  shard.entries.emplace_front(key, move(route));
+  shard.entry_by_key[key] = begin(shard.entries);
+  shard.bytes += entry_bytes;
+
+  while (shard.bytes > shard_budget_bytes_) {
+    const auto& [evicted_key, evicted_route] = shard.entries.back();
+    shard.bytes -= ComputeEntryBytes(evicted_route);
+    shard.entry_by_key.erase(evicted_key);
+    shard.entries.pop_back();
+  }
+}
+
+void RouteCache::Clear() {
+  for (Shard& shard : shards_) {
+    lock_guard guard(shard.mutex);
+    shard.entries.clear();
+    shard.entry_by_key.clear();
+    shard.bytes = 0;
+  }
+}
+
+RouteCache::Stats RouteCache::GetStats() const {
+  Stats stats;
+  for (const Shard& shard : shards_) {
+    lock_guard guard(shard.mutex);
+    stats.hit_count += shard.hit_count;
+    stats.miss_count += shard.miss_count;
+    stats.route_count += shard.entries.size();
+    stats.bytes += shard.bytes;
+  }
+  return stats;
+}
+
+size_t RouteCache::ComputeEntryBytes(const RouteHolder& route) {
+  // A rough guess at the nodes, with a pointer or two of overhead each
+  const size_t node_bytes = sizeof(Entries::value_type) + 2 * sizeof(void*) +
+                            sizeof(Key) + sizeof(Entries::iterator) +
+                            2 * sizeof(void*);
+  if (!route) {
+    return node_bytes;
+  }
+  return node_bytes + sizeof(*route) + GetCapacityBytes(route->items);
+}
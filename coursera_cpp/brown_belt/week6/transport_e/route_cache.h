@@ -0,0 +1,71 @@
+#pragma once
+
+#include "descriptions.h"
+#include "transport_router.h"
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+// Found routes by pairs of stops, shared by threads answering requests.
+// Pairs are spread over shards, each with its own lock and order of use, so
+// threads rarely wait for each other. A shard drops its least recently used
+// routes once they take more than its part of the memory budget.
+class RouteCache {
+ public:
+  // Null if there is no route
+  using RouteHolder = std::shared_ptr<const TransportRouter::RouteInfo>;
+
+  explicit RouteCache(size_t budget_bytes);
+
+  // nullopt if the route of the pair hasn't been added
+  std::optional<RouteHolder> Find(Descriptions::StopId from,
+                                   Descriptions::StopId to);
+  void Add(Descriptions::StopId from,
+           Descriptions::StopId to,
+           RouteHolder route);
+
+  void Clear();
+
+  struct Stats {
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+    size_t route_count = 0;
+    size_t bytes = 0;
+  };
+
+  Stats GetStats() const;
+
+ private:
+  static constexpr size_t SHARD_COUNT = 16;
+
+  using Key = uint64_t;
+  using Entries = std::list<std::pair<Key, RouteHolder>>;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    Entries entries;  // most recently used first
+    std::unordered_map<Key, Entries::iterator> entry_by_key;
+    size_t bytes = 0;
+    // Counted here rather than in shared atomics, the lock is taken anyway
+    uint64_t hit_count = 0;
+    uint64_t miss_count = 0;
+  };
+
+  static Key MakeKey(Descriptions::StopId from, Descriptions::StopId to) {
+    return (Key{from} << 32) | to;
+  }
+
+  Shard& GetShard(Key key) { return shards_[key % SHARD_COUNT]; }
+
+  // Of the route along with its list and map nodes
+  static size_t ComputeEntryBytes(const RouteHolder& route);
+
+  size_t shard_budget_bytes_;
+  std::array<Shard, SHARD_COUNT> shards_;
+};
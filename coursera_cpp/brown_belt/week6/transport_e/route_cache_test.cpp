@@ -0,0 +1,87 @@
+#include "route_cache_test.h"
+#include "route_cache.h"
+#include "test_runner.h"
+#include "transport_router.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Items are allocated to the exact count, so routes of one count take the
+// same memory
+RouteCache::RouteHolder MakeRoute(size_t item_count) {
+  TransportRouter::RouteInfo route = {
+      .total_time = double(item_count),
+      .items = vector<TransportRouter::RouteInfo::Item>(item_count),
+  };
+  return make_shared<const TransportRouter::RouteInfo>(move(route));
+}
+
+size_t ComputeEntryBytes(size_t item_count) {
+  RouteCache cache(1 << 20);
+  cache.Add(0, 0, MakeRoute(item_count));
+  return cache.GetStats().bytes;
+}
+
+void TestRouteCacheFind() {
+  RouteCache cache(1 << 20);
+  ASSERT(!cache.Find(0, 1));
+  cache.Add(0, 1, MakeRoute(3));
+  // Stops without a route between them are cached as well
+  cache.Add(1, 0, nullptr);
+
+  const auto route = cache.Find(0, 1);
+  ASSERT(route && *route);
+  ASSERT_EQUAL((*route)->total_time, 3.0);
+  const auto no_route = cache.Find(1, 0);
+  ASSERT(no_route && !*no_route);
+  ASSERT(!cache.Find(1, 1));
+
+  const RouteCache::Stats stats = cache.GetStats();
+  ASSERT_EQUAL(stats.hit_count, 2u);
+  ASSERT_EQUAL(stats.miss_count, 2u);
+  ASSERT_EQUAL(stats.route_count, 2u);
+
+  cache.Clear();
+  ASSERT(!cache.Find(0, 1));
+  ASSERT_EQUAL(cache.GetStats().route_count, 0u);
+  ASSERT_EQUAL(cache.GetStats().bytes, 0u);
+}
+
+// The checks hold whichever shard each pair goes to: a shard has room for
+// a few routes, the ones just added or found are the last to go, and the
+// budget is never exceeded
+void TestRouteCacheEviction() {
+  const size_t item_count = 4;
+  const size_t entry_bytes = ComputeEntryBytes(item_count);
+  // Four routes in each of up to 16 shards
+  const size_t budget_bytes = 16 * 4 * entry_bytes;
+  RouteCache cache(budget_bytes);
+
+  cache.Add(0, 0, MakeRoute(item_count));
+  for (Descriptions::StopId stop_to = 1; stop_to < 1000; ++stop_to) {
+    cache.Add(0, stop_to, MakeRoute(item_count));
+    const RouteCache::Stats stats = cache.GetStats();
+    ASSERT(stats.bytes <= budget_bytes);
+    ASSERT_EQUAL(stats.bytes, stats.route_count * entry_bytes);
+    ASSERT(cache.Find(0, stop_to).has_value());
+    ASSERT(cache.Find(0, 0).has_value());
+  }
+  ASSERT(cache.GetStats().route_count <= 16 * 4);
+
+  // A route which takes more than a shard may is not kept at all
+  const size_t huge_item_count =
+      budget_bytes / sizeof(TransportRouter::RouteInfo::Item);
+  cache.Add(1, 1, MakeRoute(huge_item_count));
+  ASSERT(!cache.Find(1, 1));
+  ASSERT(cache.GetStats().bytes <= budget_bytes);
+}
+
+void RunRouteCacheTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestRouteCacheFind);
+  RUN_TEST(tr, TestRouteCacheEviction);
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Runs with the test mode of main, exits with 1 if some test fails
+void RunRouteCacheTests();
@@ -1,37 +1,45 @@
 #pragma once
 
 #include "graph.h"
+#include "irouter.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace Graph {
 
 template <typename Weight>
-class Router {
+class Router : public IRouter<Weight> {
  private:
   using Graph = DirectedWeightedGraph<Weight>;
 
  public:
   Router(const Graph& graph);
 
-  using RouteId = uint64_t;
+  using typename IRouter<Weight>::RouteInfo;
 
-  struct RouteInfo {
-    RouteId id;
-    Weight weight;
-    size_t edge_count;
-  };
+  std::optional<Weight> WriteRoute(VertexId from,
+                                   VertexId to,
+                                   std::vector<EdgeId>& edges) const override;
+
+  std::vector<std::optional<Weight>> ComputeRouteWeights(
+      VertexId from,
+      const std::vector<VertexId>& targets) const override;
+
+  // Writes flat matrices which BlockedFloydWarshallRouter loads
+  void Serialize(Serialization::Writer& writer) const override;
 
-  std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
-  EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
-  void ReleaseRoute(RouteId route_id);
+  size_t ComputeMemoryUsage() const override;
+
+  // Relaxes all routes through each new edge, which takes a square of the
+  // vertex count per edge instead of a cube for the whole table
+  bool AddEdges(EdgeId first_new_edge) override;
 
  private:
   const Graph& graph_;
@@ -43,10 +51,6 @@ class Router {
   using RoutesInternalData =
       std::vector<std::vector<std::optional<RouteInternalData>>>;
 
-  using ExpandedRoute = std::vector<EdgeId>;
-  mutable RouteId next_route_id_ = 0;
-  mutable std::unordered_map<RouteId, ExpandedRoute> expanded_routes_cache_;
-
   void InitializeRoutesInternalData(const Graph& graph) {
     const size_t vertex_count = graph.GetVertexCount();
     for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
@@ -91,6 +95,35 @@ class Router {
     }
   }
 
+  // Routes from the end of an edge don't change while relaxing through it,
+  // as a route through the edge back to its end can't be shorter
+  void RelaxRoutesThroughEdge(EdgeId edge_id) {
+    const auto& edge = graph_.GetEdge(edge_id);
+    assert(edge.weight >= 0);
+    const auto& routes_after = routes_internal_data_[edge.to];
+    for (auto& routes_from : routes_internal_data_) {
+      const auto& route_to_start = routes_from[edge.from];
+      if (!route_to_start) {
+        continue;
+      }
+      const RouteInternalData route_through = {
+          route_to_start->weight + edge.weight, edge_id};
+      for (VertexId vertex_to = 0; vertex_to < routes_after.size();
+           ++vertex_to) {
+        if (const auto& route_after = routes_after[vertex_to]) {
+          auto& route_relaxing = routes_from[vertex_to];
+          const Weight candidate_weight =
+              route_through.weight + route_after->weight;
+          if (!route_relaxing || candidate_weight < route_relaxing->weight) {
+            route_relaxing = {candidate_weight, route_after->prev_edge
+                                                    ? route_after->prev_edge
+                                                    : route_through.prev_edge};
+          }
+        }
+      }
+    }
+  }
+
   RoutesInternalData routes_internal_data_;
 };
 
@@ -110,15 +143,15 @@ Router<Weight>::Router(const Graph& graph)
 }
 
 template <typename Weight>
-std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(
+std::optional<Weight> Router<Weight>::WriteRoute(
     VertexId from,
-    VertexId to) const {
+    VertexId to,
+    std::vector<EdgeId>& edges) const {
   const auto& route_internal_data = routes_internal_data_[from][to];
   if (!route_internal_data) {
     return std::nullopt;
   }
-  const Weight weight = route_internal_data->weight;
-  std::vector<EdgeId> edges;
+  edges.clear();
   for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge; edge_id;
        edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]
                      ->prev_edge) {
@@ -126,20 +159,75 @@ std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(
   }
   std::reverse(std::begin(edges), std::end(edges));
 
-  const RouteId route_id = next_route_id_++;
-  const size_t route_edge_count = edges.size();
-  expanded_routes_cache_[route_id] = std::move(edges);
-  return RouteInfo{route_id, weight, route_edge_count};
+  return route_internal_data->weight;
 }
 
 template <typename Weight>
-EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
-  return expanded_routes_cache_.at(route_id)[edge_idx];
+std::vector<std::optional<Weight>> Router<Weight>::ComputeRouteWeights(
+    VertexId from,
+    const std::vector<VertexId>& targets) const {
+  std::vector<std::optional<Weight>> weights;
+  weights.reserve(targets.size());
+  for (const VertexId to : targets) {
+    const auto& route_internal_data = routes_internal_data_[from][to];
+    weights.push_back(route_internal_data
+                          ? std::optional(route_internal_data->weight)
+                          : std::nullopt);
+  }
+  return weights;
 }
 
 template <typename Weight>
-void Router<Weight>::ReleaseRoute(RouteId route_id) {
-  expanded_routes_cache_.erase(route_id);
+bool Router<Weight>::AddEdges(EdgeId first_new_edge) {
+  const size_t vertex_count = graph_.GetVertexCount();
+  const size_t old_vertex_count = routes_internal_data_.size();
+  for (auto& routes_from : routes_internal_data_) {
+    routes_from.resize(vertex_count);
+  }
+  routes_internal_data_.resize(
+      vertex_count,
+      std::vector<std::optional<RouteInternalData>>(vertex_count));
+  for (VertexId vertex = old_vertex_count; vertex < vertex_count; ++vertex) {
+    routes_internal_data_[vertex][vertex] = RouteInternalData{0, std::nullopt};
+  }
+
+  for (EdgeId edge_id = first_new_edge; edge_id < graph_.GetEdgeCount();
+       ++edge_id) {
+    RelaxRoutesThroughEdge(edge_id);
+  }
+  return true;
+}
+
+template <typename Weight>
+size_t Router<Weight>::ComputeMemoryUsage() const {
+  size_t bytes = GetCapacityBytes(routes_internal_data_);
+  for (const auto& routes_from : routes_internal_data_) {
+    bytes += GetCapacityBytes(routes_from);
+  }
+  return bytes;
+}
+
+template <typename Weight>
+void Router<Weight>::Serialize(Serialization::Writer& writer) const {
+  const size_t vertex_count = graph_.GetVertexCount();
+  writer.Write(static_cast<uint64_t>(vertex_count));
+
+  writer.StartArray<Weight>(vertex_count * vertex_count);
+  for (const auto& routes_from : routes_internal_data_) {
+    for (const auto& route : routes_from) {
+      writer.Write(route ? route->weight
+                         : std::numeric_limits<Weight>::infinity());
+    }
+  }
+
+  writer.StartArray<EdgeId>(vertex_count * vertex_count);
+  for (const auto& routes_from : routes_internal_data_) {
+    for (const auto& route : routes_from) {
+      writer.Write(route && route->prev_edge
+                       ? *route->prev_edge
+                       : std::numeric_limits<EdgeId>::max());
+    }
+  }
 }
 
 }  // namespace Graph
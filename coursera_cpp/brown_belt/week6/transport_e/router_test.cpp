@@ -0,0 +1,148 @@
+#include "router_test.h"
+#include "blocked_floyd_warshall_router.h"
+#include "contraction_hierarchies_router.h"
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "irouter.h"
+#include "router.h"
+#include "test_runner.h"
+
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Graph {
+
+using TestGraph = DirectedWeightedGraph<double>;
+
+// Whole weights, so that sums don't depend on the order of additions
+void AddRandomEdges(TestGraph& graph, size_t edge_count, mt19937& generator) {
+  uniform_int_distribution<VertexId> vertex_distribution(
+      0, graph.GetVertexCount() - 1);
+  uniform_int_distribution<int> weight_distribution(1, 20);
+  for (size_t edge_idx = 0; edge_idx < edge_count; ++edge_idx) {
+    graph.AddEdge({.from = vertex_distribution(generator),
+                   .to = vertex_distribution(generator),
+                   .weight = double(weight_distribution(generator))});
+  }
+}
+
+// Has a few vertices no edge reaches
+TestGraph MakeRandomGraph(size_t vertex_count, mt19937& generator) {
+  TestGraph graph(vertex_count);
+  AddRandomEdges(graph, vertex_count * 3, generator);
+  graph.Freeze();
+  return graph;
+}
+
+// Grows graph by extra_vertex_count vertices with edges from the old ones
+// as well, returns the first new edge
+EdgeId ExtendGraph(TestGraph& graph,
+                   size_t extra_vertex_count,
+                   mt19937& generator) {
+  const EdgeId first_new_edge = graph.GetEdgeCount();
+  graph.Unfreeze();
+  graph.AddVertices(extra_vertex_count);
+  AddRandomEdges(graph, extra_vertex_count * 3, generator);
+  graph.Freeze();
+  return first_new_edge;
+}
+
+// Weights must be the ones Router finds, edges may differ between equal
+// routes but must make a path of that weight
+void CheckRoutes(const TestGraph& graph,
+                 const IRouter<double>& router,
+                 const string& name) {
+  const Router<double> expected_router(graph);
+  vector<VertexId> targets(graph.GetVertexCount());
+  for (VertexId vertex = 0; vertex < targets.size(); ++vertex) {
+    targets[vertex] = vertex;
+  }
+
+  vector<EdgeId> edges;
+  for (VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+    const auto weights = router.ComputeRouteWeights(from, targets);
+    ASSERT_EQUAL(weights.size(), targets.size());
+    for (const VertexId to : targets) {
+      ostringstream hint;
+      hint << name << ", " << from << " -> " << to;
+      const auto expected = expected_router.BuildRoute(from, to);
+      const auto weight = router.WriteRoute(from, to, edges);
+      AssertEqual(weight.has_value(), expected.has_value(), hint.str());
+      AssertEqual(weights[to].has_value(), expected.has_value(),
+                  hint.str());
+      if (!expected) {
+        continue;
+      }
+      AssertEqual(*weight, expected->weight, hint.str());
+      AssertEqual(*weights[to], expected->weight, hint.str());
+
+      VertexId vertex = from;
+      double edges_weight = 0;
+      for (const EdgeId edge_id : edges) {
+        const auto& edge = graph.GetEdge(edge_id);
+        AssertEqual(edge.from, vertex, hint.str());
+        vertex = edge.to;
+        edges_weight += edge.weight;
+      }
+      AssertEqual(vertex, to, hint.str());
+      AssertEqual(edges_weight, expected->weight, hint.str());
+    }
+  }
+}
+
+// Checks the router built by make_router, then again once the graph grows,
+// built anew if it can't take the new edges. The graph grows past 128
+// vertices, so matrices of blocks of 64 have to grow as well.
+template <typename MakeRouter>
+void CheckRouter(const string& name, MakeRouter make_router) {
+  mt19937 generator(17);
+  TestGraph graph = MakeRandomGraph(120, generator);
+  unique_ptr<IRouter<double>> router = make_router(graph);
+  CheckRoutes(graph, *router, name);
+
+  const EdgeId first_new_edge = ExtendGraph(graph, 20, generator);
+  if (!router->AddEdges(first_new_edge)) {
+    router = make_router(graph);
+  }
+  CheckRoutes(graph, *router, name + " after AddEdges");
+}
+
+void TestDijkstraRouter() {
+  CheckRouter("dijkstra", [](const TestGraph& graph) {
+    return make_unique<DijkstraRouter<double>>(graph);
+  });
+  // Keeps no more than a tree at a time
+  CheckRouter("dijkstra, small cache", [](const TestGraph& graph) {
+    return make_unique<DijkstraRouter<double>>(graph, 1);
+  });
+}
+
+// Can't take new edges, so it is built anew on the grown graph
+void TestContractionHierarchiesRouter() {
+  CheckRouter("contraction hierarchies", [](const TestGraph& graph) {
+    return make_unique<ContractionHierarchiesRouter<double>>(graph);
+  });
+}
+
+void TestBlockedFloydWarshallRouter() {
+  CheckRouter("blocked floyd-warshall", [](const TestGraph& graph) {
+    return make_unique<BlockedFloydWarshallRouter<double>>(graph);
+  });
+  CheckRouter("blocked floyd-warshall, 3 threads", [](const TestGraph& graph) {
+    return make_unique<BlockedFloydWarshallRouter<double>>(graph, 3);
+  });
+}
+
+void RunTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestDijkstraRouter);
+  RUN_TEST(tr, TestContractionHierarchiesRouter);
+  RUN_TEST(tr, TestBlockedFloydWarshallRouter);
+}
+
+}  // namespace Graph
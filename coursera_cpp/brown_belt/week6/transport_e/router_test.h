@@ -0,0 +1,6 @@
+#pragma once
+
+namespace Graph {
+// Runs with the test mode of main, exits with 1 if some test fails
+void RunTests();
+}  // namespace Graph
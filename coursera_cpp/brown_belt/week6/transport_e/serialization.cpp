@@ -0,0 +1,73 @@
+#include "serialization.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace Serialization {
+
+void Writer::WriteString(string_view value) {
+  Write(static_cast<uint64_t>(value.size()));
+  WriteBytes(value.data(), value.size());
+}
+
+void Writer::WriteBytes(const void* data, size_t size) {
+  output_.write(static_cast<const char*>(data), size);
+  offset_ += size;
+}
+
+void Writer::Align(size_t alignment) {
+  static const char padding[alignof(max_align_t)] = {};
+  WriteBytes(padding, (alignment - offset_ % alignment) % alignment);
+}
+
+string Reader::ReadString() {
+  const size_t size = Read<uint64_t>();
+  return string(TakeBytes(size), size);
+}
+
+const char* Reader::TakeBytes(size_t size) {
+  if (size > data_.size() - offset_) {
+    throw runtime_error("unexpected end of serialized data");
+  }
+  const char* bytes = data_.data() + offset_;
+  offset_ += size;
+  return bytes;
+}
+
+void Reader::Align(size_t alignment) {
+  TakeBytes((alignment - offset_ % alignment) % alignment);
+}
+
+MappedFile::MappedFile(const string& file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("can't open " + file_name);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    close(fd);
+    throw runtime_error("can't stat " + file_name);
+  }
+  size_ = file_stat.st_size;
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw runtime_error("can't map " + file_name);
+    }
+    data_ = static_cast<const char*>(data);
+  }
+  close(fd);  // the mapping stays valid
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+}  // namespace Serialization
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Plain binary format in native byte order. Arrays are aligned to their
+// element type within the file, so a reader over a memory-mapped file can
+// hand them out as views without copying.
+namespace Serialization {
+
+class Writer {
+ public:
+  explicit Writer(std::ostream& output) : output_(output) {}
+
+  template <typename T>
+  void Write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(&value, sizeof(value));
+  }
+
+  void WriteString(std::string_view value);
+
+  // Starts an array of count items, which are then written one by one
+  template <typename T>
+  void StartArray(size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    Write(static_cast<uint64_t>(count));
+    Align(alignof(T));
+  }
+
+  template <typename T>
+  void WriteArray(const T* data, size_t count) {
+    StartArray<T>(count);
+    WriteBytes(data, count * sizeof(T));
+  }
+
+ private:
+  void WriteBytes(const void* data, size_t size);
+  void Align(size_t alignment);
+
+  std::ostream& output_;
+  size_t offset_ = 0;
+};
+
+class Reader {
+ public:
+  // data should start at an address aligned for any array item
+  explicit Reader(std::string_view data) : data_(data) {}
+
+  template <typename T>
+  T Read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::memcpy(&value, TakeBytes(sizeof(value)), sizeof(value));
+    return value;
+  }
+
+  std::string ReadString();
+
+  template <typename T>
+  Range<const T*> ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const size_t count = Read<uint64_t>();
+    Align(alignof(T));
+    const auto* begin =
+        reinterpret_cast<const T*>(TakeBytes(count * sizeof(T)));
+    return {begin, begin + count};
+  }
+
+ private:
+  const char* TakeBytes(size_t size);
+  void Align(size_t alignment);
+
+  std::string_view data_;
+  size_t offset_ = 0;
+};
+
+// Read-only memory mapping of a whole file, pages are loaded on first access
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  std::string_view GetData() const { return {data_, size_}; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace Serialization
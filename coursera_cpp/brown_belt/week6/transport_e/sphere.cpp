@@ -1,5 +1,7 @@
 #include "sphere.h"
 
+#include <algorithm>
+
 using namespace std;
 
 namespace Sphere {
@@ -14,8 +16,6 @@ Point Point::FromDegrees(double latitude, double longitude) {
           ConvertDegreesToRadians(longitude)};
 }
 
-const double EARTH_RADIUS = 6'371'000;
-
 double Distance(Point lhs, Point rhs) {
   lhs = Point::FromDegrees(lhs.latitude, lhs.longitude);
   rhs = Point::FromDegrees(rhs.latitude, rhs.longitude);
@@ -24,4 +24,37 @@ double Distance(Point lhs, Point rhs) {
                   cos(abs(lhs.longitude - rhs.longitude))) *
          EARTH_RADIUS;
 }
+
+void UnitVectors::Reserve(size_t count) {
+  x.reserve(count);
+  y.reserve(count);
+  z.reserve(count);
+}
+
+void UnitVectors::Add(Point point) {
+  point = Point::FromDegrees(point.latitude, point.longitude);
+  x.push_back(cos(point.latitude) * cos(point.longitude));
+  y.push_back(cos(point.latitude) * sin(point.longitude));
+  z.push_back(sin(point.latitude));
+}
+
+void Distances(const UnitVectors& vectors,
+               const uint32_t* from,
+               const uint32_t* to,
+               size_t count,
+               double* distances) {
+  // Dot products go first in a loop of their own, which the compiler can
+  // vectorize as it holds no calls
+  const double* x = vectors.x.data();
+  const double* y = vectors.y.data();
+  const double* z = vectors.z.data();
+  for (size_t i = 0; i < count; ++i) {
+    distances[i] = x[from[i]] * x[to[i]] + y[from[i]] * y[to[i]] +
+                   z[from[i]] * z[to[i]];
+  }
+  // Rounding may take the product of close points a little above one
+  for (size_t i = 0; i < count; ++i) {
+    distances[i] = acos(clamp(distances[i], -1.0, 1.0)) * EARTH_RADIUS;
+  }
+}
 }  // namespace Sphere
@@ -1,8 +1,13 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
 
 namespace Sphere {
+const double EARTH_RADIUS = 6'371'000;  // in meters
+
 double ConvertDegreesToRadians(double degrees);
 
 struct Point {
@@ -13,4 +18,23 @@ struct Point {
 };
 
 double Distance(Point lhs, Point rhs);
+
+// Points as unit vectors from the center of the sphere, each coordinate in
+// its own array. A distance then takes a dot product and acos, with no
+// trigonometry per point.
+struct UnitVectors {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+
+  void Reserve(size_t count);
+  void Add(Point point);
+};
+
+// distances[i] = distance between points from[i] and to[i] of vectors
+void Distances(const UnitVectors& vectors,
+               const uint32_t* from,
+               const uint32_t* to,
+               size_t count,
+               double* distances);
 }  // namespace Sphere
@@ -0,0 +1,227 @@
+#include "stop_index.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+
+using namespace std;
+
+// Average number of stops per cell the grid is sized for
+const double STOPS_PER_CELL = 4;
+const double MIN_CELL_SIZE = 1;  // in meters
+
+StopIndex::StopIndex(const vector<Sphere::Point>& positions)
+    : positions_(positions) {
+  LOG_PHASE("stop_index");
+  if (positions_.empty()) {
+    cell_offsets_.assign(1, 0);
+    return;
+  }
+
+  const auto [min_latitude, max_latitude] = minmax_element(
+      begin(positions_), end(positions_), [](const auto& lhs, const auto& rhs) {
+        return lhs.latitude < rhs.latitude;
+      });
+  grid_.reference_latitude_cos = cos(Sphere::ConvertDegreesToRadians(
+      (min_latitude->latitude + max_latitude->latitude) / 2));
+  grid_.min_latitude_cos =
+      min(cos(Sphere::ConvertDegreesToRadians(min_latitude->latitude)),
+          cos(Sphere::ConvertDegreesToRadians(max_latitude->latitude)));
+
+  vector<PlanePoint> plane_points;
+  plane_points.reserve(positions_.size());
+  for (const auto& position : positions_) {
+    plane_points.push_back(Project(position));
+  }
+  const auto [min_x, max_x] = minmax_element(
+      begin(plane_points), end(plane_points),
+      [](const auto& lhs, const auto& rhs) { return lhs.x < rhs.x; });
+  const auto [min_y, max_y] = minmax_element(
+      begin(plane_points), end(plane_points),
+      [](const auto& lhs, const auto& rhs) { return lhs.y < rhs.y; });
+  grid_.min_x = min_x->x;
+  grid_.min_y = min_y->y;
+
+  // The second bound keeps stops lying along a line from getting a cell each
+  const double width = max_x->x - min_x->x;
+  const double height = max_y->y - min_y->y;
+  const double cells_wanted = positions_.size() / STOPS_PER_CELL;
+  grid_.cell_size = max({sqrt(width * height / cells_wanted),
+                         max(width, height) / cells_wanted, MIN_CELL_SIZE});
+  grid_.column_count = static_cast<uint32_t>(width / grid_.cell_size) + 1;
+  grid_.row_count = static_cast<uint32_t>(height / grid_.cell_size) + 1;
+
+  const size_t cell_count = size_t{grid_.column_count} * grid_.row_count;
+  vector<size_t> stop_cells;
+  stop_cells.reserve(positions_.size());
+  cell_offsets_.assign(cell_count + 1, 0);
+  for (const auto& plane_point : plane_points) {
+    const size_t cell = size_t{GetRow(plane_point.y)} * grid_.column_count +
+                        GetColumn(plane_point.x);
+    stop_cells.push_back(cell);
+    ++cell_offsets_[cell + 1];
+  }
+  for (size_t cell = 0; cell < cell_count; ++cell) {
+    cell_offsets_[cell + 1] += cell_offsets_[cell];
+  }
+
+  cell_stops_.resize(positions_.size());
+  vector<uint32_t> next_stop_idx(begin(cell_offsets_),
+                                 prev(end(cell_offsets_)));
+  for (Descriptions::StopId stop_id = 0; stop_id < positions_.size();
+       ++stop_id) {
+    cell_stops_[next_stop_idx[stop_cells[stop_id]]++] = stop_id;
+  }
+}
+
+StopIndex::StopIndex(Serialization::Reader& reader)
+    : grid_(reader.Read<Grid>()) {
+  const auto positions = reader.ReadArray<Sphere::Point>();
+  positions_.assign(positions.begin(), positions.end());
+  const auto cell_offsets = reader.ReadArray<uint32_t>();
+  cell_offsets_.assign(cell_offsets.begin(), cell_offsets.end());
+  const auto cell_stops = reader.ReadArray<Descriptions::StopId>();
+  cell_stops_.assign(cell_stops.begin(), cell_stops.end());
+
+  if (cell_offsets_.size() !=
+          size_t{grid_.column_count} * grid_.row_count + 1 ||
+      cell_stops_.size() != positions_.size()) {
+    throw runtime_error("stop index of the snapshot is inconsistent");
+  }
+}
+
+void StopIndex::Serialize(Serialization::Writer& writer) const {
+  writer.Write(grid_);
+  writer.WriteArray(positions_.data(), positions_.size());
+  writer.WriteArray(cell_offsets_.data(), cell_offsets_.size());
+  writer.WriteArray(cell_stops_.data(), cell_stops_.size());
+}
+
+StopIndex::PlanePoint StopIndex::Project(Sphere::Point point) const {
+  return {Sphere::ConvertDegreesToRadians(point.longitude) *
+              grid_.reference_latitude_cos * Sphere::EARTH_RADIUS,
+          Sphere::ConvertDegreesToRadians(point.latitude) *
+              Sphere::EARTH_RADIUS};
+}
+
+double StopIndex::GetMaxStretch(Sphere::Point point) const {
+  const double min_latitude_cos =
+      min(grid_.min_latitude_cos,
+          cos(Sphere::ConvertDegreesToRadians(point.latitude)));
+  return min_latitude_cos > 0
+             ? max(grid_.reference_latitude_cos / min_latitude_cos, 1.0)
+             : numeric_limits<double>::infinity();
+}
+
+uint32_t ClampToGrid(double cell, uint32_t cell_count) {
+  if (cell < 0) {
+    return 0;
+  }
+  return cell >= cell_count ? cell_count - 1 : static_cast<uint32_t>(cell);
+}
+
+uint32_t StopIndex::GetColumn(double x) const {
+  return ClampToGrid(floor((x - grid_.min_x) / grid_.cell_size),
+                     grid_.column_count);
+}
+
+uint32_t StopIndex::GetRow(double y) const {
+  return ClampToGrid(floor((y - grid_.min_y) / grid_.cell_size),
+                     grid_.row_count);
+}
+
+void StopIndex::CollectCell(uint32_t column,
+                            uint32_t row,
+                            Sphere::Point point,
+                            double radius,
+                            vector<Neighbor>& neighbors) const {
+  const size_t cell = size_t{row} * grid_.column_count + column;
+  for (uint32_t stop_idx = cell_offsets_[cell];
+       stop_idx < cell_offsets_[cell + 1]; ++stop_idx) {
+    const auto stop_id = cell_stops_[stop_idx];
+    const double distance = Sphere::Distance(point, positions_[stop_id]);
+    if (distance <= radius) {
+      neighbors.push_back({stop_id, distance});
+    }
+  }
+}
+
+bool IsCloser(const StopIndex::Neighbor& lhs, const StopIndex::Neighbor& rhs) {
+  return tie(lhs.distance, lhs.stop_id) < tie(rhs.distance, rhs.stop_id);
+}
+
+vector<StopIndex::Neighbor> StopIndex::FindNearest(Sphere::Point point,
+                                                   size_t count) const {
+  count = min(count, positions_.size());
+  if (count == 0) {
+    return {};
+  }
+
+  // Stops outside the cells seen so far lie farther than ring_step for each
+  // ring around the cell of the point
+  const PlanePoint center = Project(point);
+  const int64_t center_column = GetColumn(center.x);
+  const int64_t center_row = GetRow(center.y);
+  const double ring_step = grid_.cell_size / GetMaxStretch(point);
+  const int64_t max_ring = max(grid_.column_count, grid_.row_count);
+  const double no_limit = numeric_limits<double>::infinity();
+
+  vector<Neighbor> neighbors;
+  for (int64_t ring = 0; ring <= max_ring; ++ring) {
+    const int64_t first_row = max<int64_t>(center_row - ring, 0);
+    const int64_t last_row =
+        min<int64_t>(center_row + ring, grid_.row_count - 1);
+    const int64_t first_column = max<int64_t>(center_column - ring, 0);
+    const int64_t last_column =
+        min<int64_t>(center_column + ring, grid_.column_count - 1);
+    for (int64_t row = first_row; row <= last_row; ++row) {
+      // Rows inside the ring have cells on its sides only
+      const int64_t column_step =
+          abs(row - center_row) == ring ? 1 : max<int64_t>(2 * ring, 1);
+      for (int64_t column = center_column - ring; column <= last_column;
+           column += column_step) {
+        if (column >= first_column) {
+          CollectCell(column, row, point, no_limit, neighbors);
+        }
+      }
+    }
+
+    if (neighbors.size() >= count) {
+      nth_element(begin(neighbors), begin(neighbors) + count - 1,
+                  end(neighbors), IsCloser);
+      neighbors.resize(count);
+      if (neighbors.back().distance <= ring * ring_step) {
+        break;
+      }
+    }
+  }
+
+  sort(begin(neighbors), end(neighbors), IsCloser);
+  return neighbors;
+}
+
+vector<StopIndex::Neighbor> StopIndex::FindInRadius(Sphere::Point point,
+                                                    double radius) const {
+  if (positions_.empty() || radius < 0) {
+    return {};
+  }
+
+  const PlanePoint center = Project(point);
+  const double x_radius = radius * GetMaxStretch(point);
+  const uint32_t last_row = GetRow(center.y + radius);
+  const uint32_t last_column = GetColumn(center.x + x_radius);
+
+  vector<Neighbor> neighbors;
+  for (uint32_t row = GetRow(center.y - radius); row <= last_row; ++row) {
+    for (uint32_t column = GetColumn(center.x - x_radius);
+         column <= last_column; ++column) {
+      CollectCell(column, row, point, radius, neighbors);
+    }
+  }
+
+  sort(begin(neighbors), end(neighbors), IsCloser);
+  return neighbors;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "descriptions.h"
+#include "serialization.h"
+#include "sphere.h"
+
+#include <cstdint>
+#include <vector>
+
+// Uniform grid over stops projected onto a plane tangent at the middle
+// latitude of the stops. Cells are sized for a few stops each, so a query
+// looks at cells around its point only and measures exact distances to the
+// stops found there. Meant for distances much smaller than the Earth radius.
+class StopIndex {
+ public:
+  StopIndex() = default;
+  // Positions are indexed by StopId
+  explicit StopIndex(const std::vector<Sphere::Point>& positions);
+  explicit StopIndex(Serialization::Reader& reader);
+
+  void Serialize(Serialization::Writer& writer) const;
+
+  struct Neighbor {
+    Descriptions::StopId stop_id;
+    double distance;  // in meters
+  };
+
+  // Results are ordered by distance, then by stop id
+
+  // At most count stops closest to the point
+  std::vector<Neighbor> FindNearest(Sphere::Point point, size_t count) const;
+
+  std::vector<Neighbor> FindInRadius(Sphere::Point point,
+                                     double radius) const;
+
+ private:
+  struct Grid {
+    double min_x = 0;
+    double min_y = 0;
+    double cell_size = 1;
+    double reference_latitude_cos = 1;
+    // Of the latitude farthest from the equator among stops
+    double min_latitude_cos = 1;
+    uint32_t column_count = 0;
+    uint32_t row_count = 0;
+  };
+
+  struct PlanePoint {
+    double x;
+    double y;
+  };
+
+  PlanePoint Project(Sphere::Point point) const;
+
+  // How much shorter than its projection an east-west distance around the
+  // point may be
+  double GetMaxStretch(Sphere::Point point) const;
+
+  uint32_t GetColumn(double x) const;
+  uint32_t GetRow(double y) const;
+
+  // Adds stops of the cell which are within radius of the point
+  void CollectCell(uint32_t column,
+                   uint32_t row,
+                   Sphere::Point point,
+                   double radius,
+                   std::vector<Neighbor>& neighbors) const;
+
+  Grid grid_;
+  std::vector<Sphere::Point> positions_;
+  // Stops of cell c are cell_stops_[cell_offsets_[c]..[c + 1]),
+  // cells go row by row
+  std::vector<uint32_t> cell_offsets_;
+  std::vector<Descriptions::StopId> cell_stops_;
+};
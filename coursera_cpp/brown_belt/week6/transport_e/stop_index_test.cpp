@@ -0,0 +1,101 @@
+#include "stop_index_test.h"
+#include "sphere.h"
+#include "stop_index.h"
+#include "test_runner.h"
+
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+// Ordered by distance, then by stop id, as the index orders them
+vector<StopIndex::Neighbor> FindAll(const vector<Sphere::Point>& positions,
+                                    Sphere::Point point) {
+  vector<StopIndex::Neighbor> neighbors;
+  for (Descriptions::StopId stop_id = 0; stop_id < positions.size();
+       ++stop_id) {
+    neighbors.push_back({stop_id, Sphere::Distance(point, positions[stop_id])});
+  }
+  sort(begin(neighbors), end(neighbors),
+       [](const StopIndex::Neighbor& lhs, const StopIndex::Neighbor& rhs) {
+         return tie(lhs.distance, lhs.stop_id) <
+                tie(rhs.distance, rhs.stop_id);
+       });
+  return neighbors;
+}
+
+void AssertSameNeighbors(const vector<StopIndex::Neighbor>& neighbors,
+                         const vector<StopIndex::Neighbor>& expected,
+                         const string& hint) {
+  AssertEqual(neighbors.size(), expected.size(), hint);
+  for (size_t idx = 0; idx < expected.size(); ++idx) {
+    AssertEqual(neighbors[idx].stop_id, expected[idx].stop_id, hint);
+    AssertEqual(neighbors[idx].distance, expected[idx].distance, hint);
+  }
+}
+
+// Queries both inside the area of the stops and far beyond it
+void CheckQueries(const vector<Sphere::Point>& positions,
+                  mt19937& generator) {
+  const StopIndex index(positions);
+  uniform_real_distribution<double> latitude_distribution(55.0, 56.4);
+  uniform_real_distribution<double> longitude_distribution(36.8, 38.4);
+  for (int query_idx = 0; query_idx < 200; ++query_idx) {
+    const Sphere::Point point = {
+        .latitude = latitude_distribution(generator),
+        .longitude = longitude_distribution(generator),
+    };
+    const auto all_neighbors = FindAll(positions, point);
+    ostringstream hint;
+    hint << positions.size() << " stops, query " << query_idx;
+
+    for (const size_t count : {size_t{0}, size_t{1}, size_t{7},
+                               positions.size(), positions.size() + 3}) {
+      const size_t expected_count = min(count, all_neighbors.size());
+      AssertSameNeighbors(
+          index.FindNearest(point, count),
+          {begin(all_neighbors), begin(all_neighbors) + expected_count},
+          hint.str() + ", count " + to_string(count));
+    }
+
+    for (const double radius : {0.0, 300.0, 2500.0, 30000.0, 1e6}) {
+      const auto expected_end =
+          find_if(begin(all_neighbors), end(all_neighbors),
+                  [radius](const auto& neighbor) {
+                    return neighbor.distance > radius;
+                  });
+      AssertSameNeighbors(index.FindInRadius(point, radius),
+                          {begin(all_neighbors), expected_end},
+                          hint.str() + ", radius " + to_string(radius));
+    }
+  }
+}
+
+void TestStopIndexQueries() {
+  mt19937 generator(13);
+  uniform_real_distribution<double> latitude_distribution(55.5, 55.9);
+  uniform_real_distribution<double> longitude_distribution(37.3, 37.9);
+  vector<Sphere::Point> positions;
+  for (int stop_idx = 0; stop_idx < 500; ++stop_idx) {
+    positions.push_back({
+        .latitude = latitude_distribution(generator),
+        .longitude = longitude_distribution(generator),
+    });
+  }
+  // Stops at the same place are ordered by id
+  positions.push_back(positions[10]);
+  positions.push_back(positions[3]);
+  CheckQueries(positions, generator);
+
+  CheckQueries({positions[0]}, generator);
+  CheckQueries({}, generator);
+}
+
+void RunStopIndexTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestStopIndexQueries);
+}
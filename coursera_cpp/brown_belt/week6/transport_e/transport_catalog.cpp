@@ -1,75 +1,371 @@
 #include "transport_catalog.h"
+#include "profiler.h"
 
+#include <algorithm>
+#include <future>
 #include <sstream>
+#include <stdexcept>
 
 using namespace std;
 
-TransportCatalog::TransportCatalog(vector<Descriptions::InputQuery> data,
-                                   const Json::Dict& routing_settings_json) {
-  auto stops_end = partition(begin(data), end(data), [](const auto& item) {
-    return holds_alternative<Descriptions::Stop>(item);
-  });
+const char SNAPSHOT_MAGIC[8] = {'T', 'C', 'A', 'T', 'S', 'N', 'A', 'P'};
+const uint32_t SNAPSHOT_VERSION = 6;
 
-  Descriptions::StopsDict stops_dict;
-  for (const auto& item : Range{begin(data), stops_end}) {
-    const auto& stop = get<Descriptions::Stop>(item);
-    stops_dict[stop.name] = &stop;
-    stops_.insert({stop.name, {}});
+// Fewer aren't worth a thread
+const size_t MIN_BUSES_PER_THREAD = 16;
+const size_t MIN_STOPS_PER_THREAD = 256;
+
+TransportCatalog::TransportCatalog(Descriptions::Input data,
+                                   const Json::Dict& routing_settings_json,
+                                   size_t thread_count)
+    : TransportCatalog(move(data),
+                       make_unique<TransportRouter>(data.stops, data.buses,
+                                                    data.road_distances,
+                                                    routing_settings_json,
+                                                    thread_count),
+                       thread_count) {}
+
+vector<Sphere::Point> CollectPositions(
+    const vector<Descriptions::Stop>& stops) {
+  vector<Sphere::Point> positions;
+  positions.reserve(stops.size());
+  for (const auto& stop : stops) {
+    positions.push_back(stop.position);
+  }
+  return positions;
+}
+
+TransportCatalog::TransportCatalog(Descriptions::Input&& data,
+                                   unique_ptr<TransportRouter> router,
+                                   size_t thread_count)
+    : thread_count_(thread_count),
+      descriptions_(move(data)),
+      stops_(descriptions_.stops.size()),
+      stop_index_(CollectPositions(descriptions_.stops)),
+      router_(move(router)) {
+  AddBusResponses(0);
+}
+
+void TransportCatalog::AddBusResponses(Descriptions::BusId first_bus_id) {
+  LOG_PHASE("bus_responses");
+  Sphere::UnitVectors stop_vectors;
+  stop_vectors.Reserve(descriptions_.stops.size());
+  for (const auto& stop : descriptions_.stops) {
+    stop_vectors.Add(stop.position);
+  }
+  const auto& road_distances = descriptions_.road_distances;
+  const auto& bus_descriptions = descriptions_.buses;
+
+  // Buses don't depend on each other, parts fill their responses in place
+  buses_.resize(bus_descriptions.size());
+  ProcessInParallel(
+      bus_descriptions.size() - first_bus_id, MIN_BUSES_PER_THREAD,
+      thread_count_, [&](size_t part_begin, size_t part_end) {
+        vector<double> distances;
+        for (size_t bus_id = first_bus_id + part_begin;
+             bus_id < first_bus_id + part_end; ++bus_id) {
+          const auto& stops = bus_descriptions[bus_id].stops;
+          Bus& bus = buses_[bus_id];
+          bus.stop_count = stops.size();
+          bus.unique_stop_count = ComputeUniqueItemsCount(AsRange(stops));
+          bus.road_route_length =
+              ComputeRoadRouteLength(stops, road_distances);
+          bus.geo_route_length =
+              ComputeGeoRouteDistance(stops, stop_vectors, distances);
+        }
+      });
+
+  vector<Descriptions::StopId> updated_stops;
+  for (size_t bus_id = first_bus_id; bus_id < bus_descriptions.size();
+       ++bus_id) {
+    const auto& bus = bus_descriptions[bus_id];
+    for (const Descriptions::StopId stop_id : bus.stops) {
+      stops_[stop_id].bus_ids.push_back(bus.id);
+      updated_stops.push_back(stop_id);
+    }
+  }
+
+  sort(begin(updated_stops), end(updated_stops));
+  updated_stops.erase(unique(begin(updated_stops), end(updated_stops)),
+                      end(updated_stops));
+  ProcessInParallel(
+      updated_stops.size(), MIN_STOPS_PER_THREAD, thread_count_,
+      [this, &updated_stops](size_t part_begin, size_t part_end) {
+        for (size_t stop_idx = part_begin; stop_idx < part_end; ++stop_idx) {
+          auto& bus_ids = stops_[updated_stops[stop_idx]].bus_ids;
+          sort(begin(bus_ids), end(bus_ids),
+               [this](const auto lhs, const auto rhs) {
+                 return GetBusName(lhs) < GetBusName(rhs);
+               });
+          bus_ids.erase(unique(begin(bus_ids), end(bus_ids)), end(bus_ids));
+        }
+      });
+}
+
+void TransportCatalog::Update(const Json::Array& nodes) {
+  const bool is_extension = Descriptions::IsExtension(descriptions_, nodes);
+  const Descriptions::StopId first_new_stop_id = descriptions_.stops.size();
+  const Descriptions::BusId first_new_bus_id = descriptions_.buses.size();
+  Descriptions::UpdateDescriptions(descriptions_, nodes);
+
+  if (is_extension) {
+    stops_.resize(descriptions_.stops.size());
+    AddBusResponses(first_new_bus_id);
+    router_->AddStopsAndBuses(descriptions_.stops, descriptions_.buses,
+                              descriptions_.road_distances, first_new_stop_id,
+                              first_new_bus_id);
+  } else {
+    stops_.assign(descriptions_.stops.size(), {});
+    buses_.clear();
+    AddBusResponses(0);
+    router_ = router_->Rebuild(descriptions_.stops, descriptions_.buses,
+                               descriptions_.road_distances);
+  }
+  // Takes a linear pass, as long as reading the descriptions
+  stop_index_ = StopIndex(CollectPositions(descriptions_.stops));
+  if (route_cache_) {
+    route_cache_->Clear();
+  }
+}
+
+void TransportCatalog::Serialize(ostream& output) const {
+  Serialization::Writer writer(output);
+  for (const char c : SNAPSHOT_MAGIC) {
+    writer.Write(c);
+  }
+  writer.Write(SNAPSHOT_VERSION);
+
+  writer.Write(static_cast<uint64_t>(stops_.size()));
+  for (size_t stop_id = 0; stop_id < stops_.size(); ++stop_id) {
+    writer.WriteString(GetStopName(stop_id));
+    const auto& bus_ids = stops_[stop_id].bus_ids;
+    writer.WriteArray(bus_ids.data(), bus_ids.size());
+  }
+
+  writer.Write(static_cast<uint64_t>(buses_.size()));
+  for (size_t bus_id = 0; bus_id < buses_.size(); ++bus_id) {
+    writer.WriteString(GetBusName(bus_id));
+  }
+  writer.WriteArray(buses_.data(), buses_.size());
+
+  // Road distances go as two arrays, pairs aren't trivially copyable
+  for (const auto& stop : descriptions_.stops) {
+    writer.Write(stop.position);
+    writer.StartArray<Descriptions::StopId>(stop.distances.size());
+    for (const auto& [neighbour_id, distance] : stop.distances) {
+      writer.Write(neighbour_id);
+    }
+    writer.StartArray<int>(stop.distances.size());
+    for (const auto& [neighbour_id, distance] : stop.distances) {
+      writer.Write(distance);
+    }
+    writer.Write(static_cast<uint64_t>(stop.pending_distances.size()));
+    for (const auto& [neighbour_name, distance] : stop.pending_distances) {
+      writer.WriteString(neighbour_name);
+      writer.Write(distance);
+    }
+  }
+  for (const auto& bus : descriptions_.buses) {
+    writer.WriteArray(bus.stops.data(), bus.stops.size());
+  }
+
+  stop_index_.Serialize(writer);
+  router_->Serialize(writer);
+}
+
+TransportCatalog TransportCatalog::Deserialize(const string& file_name,
+                                               size_t thread_count) {
+  TransportCatalog catalog;
+  catalog.thread_count_ = thread_count;
+  catalog.snapshot_ = make_unique<Serialization::MappedFile>(file_name);
+  Serialization::Reader reader(catalog.snapshot_->GetData());
+  for (const char c : SNAPSHOT_MAGIC) {
+    if (reader.Read<char>() != c) {
+      throw runtime_error(file_name + " is not a catalog snapshot");
+    }
+  }
+  if (reader.Read<uint32_t>() != SNAPSHOT_VERSION) {
+    throw runtime_error(file_name + " has unsupported snapshot version");
   }
 
-  Descriptions::BusesDict buses_dict;
-  for (const auto& item : Range{stops_end, end(data)}) {
-    const auto& bus = get<Descriptions::Bus>(item);
+  auto& descriptions = catalog.descriptions_;
+  const size_t stop_count = reader.Read<uint64_t>();
+  catalog.stops_.reserve(stop_count);
+  for (size_t stop_id = 0; stop_id < stop_count; ++stop_id) {
+    descriptions.stop_names.Intern(reader.ReadString());
+    const auto bus_ids = reader.ReadArray<Descriptions::BusId>();
+    catalog.stops_.push_back({{bus_ids.begin(), bus_ids.end()}});
+  }
 
-    buses_dict[bus.name] = &bus;
-    buses_[bus.name] =
-        Bus{bus.stops.size(), ComputeUniqueItemsCount(AsRange(bus.stops)),
-            ComputeRoadRouteLength(bus.stops, stops_dict),
-            ComputeGeoRouteDistance(bus.stops, stops_dict)};
+  const size_t bus_count = reader.Read<uint64_t>();
+  for (size_t bus_id = 0; bus_id < bus_count; ++bus_id) {
+    descriptions.bus_names.Intern(reader.ReadString());
+  }
+  const auto buses = reader.ReadArray<Bus>();
+  catalog.buses_.assign(buses.begin(), buses.end());
+  if (descriptions.stop_names.GetSize() != stop_count ||
+      descriptions.bus_names.GetSize() != bus_count ||
+      catalog.buses_.size() != bus_count) {
+    throw runtime_error(file_name + " has inconsistent names");
+  }
 
-    for (const string& stop_name : bus.stops) {
-      stops_.at(stop_name).bus_names.insert(bus.name);
+  descriptions.stops.resize(stop_count);
+  for (size_t stop_id = 0; stop_id < stop_count; ++stop_id) {
+    auto& stop = descriptions.stops[stop_id];
+    stop.id = stop_id;
+    stop.position = reader.Read<Sphere::Point>();
+    const auto neighbour_ids = reader.ReadArray<Descriptions::StopId>();
+    const auto distances = reader.ReadArray<int>();
+    const size_t distance_count = distances.end() - distances.begin();
+    if (static_cast<size_t>(neighbour_ids.end() - neighbour_ids.begin()) !=
+        distance_count) {
+      throw runtime_error(file_name + " has inconsistent road distances");
+    }
+    stop.distances.reserve(distance_count);
+    for (size_t idx = 0; idx < distance_count; ++idx) {
+      stop.distances.emplace_back(neighbour_ids.begin()[idx],
+                                  distances.begin()[idx]);
     }
+    const size_t pending_distance_count = reader.Read<uint64_t>();
+    for (size_t idx = 0; idx < pending_distance_count; ++idx) {
+      string neighbour_name = reader.ReadString();
+      stop.pending_distances.emplace_back(move(neighbour_name),
+                                          reader.Read<int>());
+    }
+  }
+  descriptions.buses.resize(bus_count);
+  for (size_t bus_id = 0; bus_id < bus_count; ++bus_id) {
+    const auto stops = reader.ReadArray<Descriptions::StopId>();
+    descriptions.buses[bus_id] = {static_cast<Descriptions::BusId>(bus_id),
+                                  {stops.begin(), stops.end()}};
   }
+  // Road distances are only used by updates, which build them anew
 
-  router_ = make_unique<TransportRouter>(stops_dict, buses_dict,
-                                         routing_settings_json);
+  catalog.stop_index_ = StopIndex(reader);
+  catalog.router_ = make_unique<TransportRouter>(reader, thread_count);
+  return catalog;
+}
+
+void TransportCatalog::ReportMemoryUsage() const {
+  size_t stop_bytes = GetCapacityBytes(stops_);
+  for (const auto& stop : stops_) {
+    stop_bytes += GetCapacityBytes(stop.bus_ids);
+  }
+  Profiler::AddContainer("stops", stops_.size(), stop_bytes);
+  Profiler::AddContainer("buses", buses_.size(), GetCapacityBytes(buses_));
+  router_->ReportMemoryUsage();
+  if (route_cache_) {
+    const auto stats = route_cache_->GetStats();
+    Profiler::AddContainer("route_cache", stats.route_count, stats.bytes);
+    Profiler::AddCounter("route_cache_hits", stats.hit_count);
+    Profiler::AddCounter("route_cache_misses", stats.miss_count);
+  }
 }
 
 const TransportCatalog::Stop* TransportCatalog::GetStop(
     const string& name) const {
-  return GetValuePointer(stops_, name);
+  const auto stop_id = descriptions_.stop_names.Find(name);
+  return stop_id ? &stops_[*stop_id] : nullptr;
 }
 
 const TransportCatalog::Bus* TransportCatalog::GetBus(
     const string& name) const {
-  return GetValuePointer(buses_, name);
+  const auto bus_id = descriptions_.bus_names.Find(name);
+  return bus_id ? &buses_[*bus_id] : nullptr;
 }
 
-optional<TransportRouter::RouteInfo> TransportCatalog::FindRoute(
+RouteCache::RouteHolder TransportCatalog::FindRoute(
     const string& stop_from,
     const string& stop_to) const {
-  return router_->FindRoute(stop_from, stop_to);
+  const auto stop_from_id = descriptions_.stop_names.GetId(stop_from);
+  const auto stop_to_id = descriptions_.stop_names.GetId(stop_to);
+  if (route_cache_) {
+    if (auto route = route_cache_->Find(stop_from_id, stop_to_id)) {
+      return move(*route);
+    }
+  }
+
+  auto route_info = router_->FindRoute(stop_from_id, stop_to_id);
+  RouteCache::RouteHolder route =
+      route_info
+          ? make_shared<const TransportRouter::RouteInfo>(move(*route_info))
+          : nullptr;
+  if (route_cache_) {
+    route_cache_->Add(stop_from_id, stop_to_id, route);
+  }
+  return route;
+}
+
+void TransportCatalog::EnableRouteCache(size_t budget_bytes) {
+  route_cache_ = make_unique<RouteCache>(budget_bytes);
+}
+
+optional<vector<Descriptions::StopId>> TransportCatalog::FindStopIds(
+    const vector<string>& names) const {
+  vector<Descriptions::StopId> stop_ids;
+  stop_ids.reserve(names.size());
+  for (const string& name : names) {
+    const auto stop_id = descriptions_.stop_names.Find(name);
+    if (!stop_id) {
+      return nullopt;
+    }
+    stop_ids.push_back(*stop_id);
+  }
+  return stop_ids;
+}
+
+optional<TransportCatalog::RouteMatrix> TransportCatalog::ComputeRouteMatrix(
+    const vector<string>& stops_from,
+    const vector<string>& stops_to,
+    size_t thread_count) const {
+  const auto ids_from = FindStopIds(stops_from);
+  const auto ids_to = FindStopIds(stops_to);
+  if (!ids_from || !ids_to) {
+    return nullopt;
+  }
+
+  RouteMatrix matrix(ids_from->size());
+  thread_count = max<size_t>(min(thread_count, ids_from->size()), 1);
+  const auto compute_rows = [&](size_t first_row) {
+    for (size_t row = first_row; row < ids_from->size(); row += thread_count) {
+      matrix[row] = router_->ComputeTotalTimes((*ids_from)[row], *ids_to);
+    }
+  };
+  vector<future<void>> futures;
+  for (size_t thread_idx = 1; thread_idx < thread_count; ++thread_idx) {
+    futures.push_back(async(launch::async, compute_rows, thread_idx));
+  }
+  compute_rows(0);
+  for (auto& future : futures) {
+    future.get();
+  }
+  return matrix;
 }
 
 int TransportCatalog::ComputeRoadRouteLength(
-    const vector<string>& stops,
-    const Descriptions::StopsDict& stops_dict) {
+    const vector<Descriptions::StopId>& stops,
+    const Descriptions::RoadDistances& road_distances) {
   int result = 0;
   for (size_t i = 1; i < stops.size(); ++i) {
-    result += Descriptions::ComputeStopsDistance(*stops_dict.at(stops[i - 1]),
-                                                 *stops_dict.at(stops[i]));
+    result += road_distances.Get(stops[i - 1], stops[i]);
   }
   return result;
 }
 
 double TransportCatalog::ComputeGeoRouteDistance(
-    const vector<string>& stops,
-    const Descriptions::StopsDict& stops_dict) {
+    const vector<Descriptions::StopId>& stops,
+    const Sphere::UnitVectors& stop_vectors,
+    vector<double>& distances) {
+  if (stops.size() <= 1) {
+    return 0;
+  }
+  distances.resize(stops.size() - 1);
+  Sphere::Distances(stop_vectors, stops.data(), stops.data() + 1,
+                    distances.size(), distances.data());
+
   double result = 0;
-  for (size_t i = 1; i < stops.size(); ++i) {
-    result += Sphere::Distance(stops_dict.at(stops[i - 1])->position,
-                               stops_dict.at(stops[i])->position);
+  for (const double distance : distances) {
+    result += distance;
   }
   return result;
 }
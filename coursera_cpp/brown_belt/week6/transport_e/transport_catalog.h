@@ -2,25 +2,31 @@
 
 #include "descriptions.h"
 #include "json.h"
+#include "route_cache.h"
+#include "serialization.h"
+#include "sphere.h"
+#include "stop_index.h"
 #include "transport_router.h"
 #include "utils.h"
 
+#include <cstdint>
+#include <memory>
 #include <optional>
-#include <set>
+#include <ostream>
 #include <string>
-#include <unordered_map>
 #include <variant>
 #include <vector>
 
 namespace Responses {
 struct Stop {
-  std::set<std::string> bus_names;
+  std::vector<Descriptions::BusId> bus_ids;  // sorted by bus name
 };
 
 struct Bus {
   size_t stop_count = 0;
   size_t unique_stop_count = 0;
-  int road_route_length = 0;
+  // 64 bits leave no padding, which would go to snapshots unset
+  int64_t road_route_length = 0;
   double geo_route_length = 0.0;
 };
 }  // namespace Responses
@@ -31,27 +37,101 @@ class TransportCatalog {
   using Stop = Responses::Stop;
 
  public:
-  TransportCatalog(std::vector<Descriptions::InputQuery> data,
-                   const Json::Dict& routing_settings_json);
+  // Responses of buses are computed on thread_count threads, and so is
+  // routing where the router supports it
+  TransportCatalog(Descriptions::Input data,
+                   const Json::Dict& routing_settings_json,
+                   size_t thread_count = 1);
+  // Takes a router built over the same data, so that it can be timed or
+  // built elsewhere
+  TransportCatalog(Descriptions::Input&& data,
+                   std::unique_ptr<TransportRouter> router,
+                   size_t thread_count = 1);
+
+  // Applies descriptions of stops and buses as Descriptions::
+  // UpdateDescriptions does. When they only add stops and buses, routing
+  // takes their edges in place. Otherwise everything is rebuilt from the
+  // kept descriptions.
+  void Update(const Json::Array& nodes);
+
+  // Writes everything needed to answer requests and updates into a
+  // versioned snapshot
+  void Serialize(std::ostream& output) const;
+  // Maps a snapshot into memory, routing tables are used in place.
+  // Updates go on thread_count threads.
+  static TransportCatalog Deserialize(const std::string& file_name,
+                                      size_t thread_count = 1);
 
   const Stop* GetStop(const std::string& name) const;
   const Bus* GetBus(const std::string& name) const;
 
-  std::optional<TransportRouter::RouteInfo> FindRoute(
-      const std::string& stop_from,
-      const std::string& stop_to) const;
+  const std::string& GetStopName(Descriptions::StopId stop_id) const {
+    return descriptions_.stop_names.GetName(stop_id);
+  }
+  const std::string& GetBusName(Descriptions::BusId bus_id) const {
+    return descriptions_.bus_names.GetName(bus_id);
+  }
+
+  // Stops ordered by distance from the point
+  std::vector<StopIndex::Neighbor> FindNearestStops(Sphere::Point point,
+                                                    size_t count) const {
+    return stop_index_.FindNearest(point, count);
+  }
+  std::vector<StopIndex::Neighbor> FindStopsInRadius(Sphere::Point point,
+                                                     double radius) const {
+    return stop_index_.FindInRadius(point, radius);
+  }
+
+  // Null if there is no route
+  RouteCache::RouteHolder FindRoute(const std::string& stop_from,
+                                    const std::string& stop_to) const;
+
+  // Keeps found routes within the budget, so that a pair asked for again
+  // costs a lookup. Off unless enabled, cleared on updates.
+  void EnableRouteCache(size_t budget_bytes);
+
+  using RouteMatrix = std::vector<TransportRouter::TotalTimes>;
+
+  // A row of total times per stop of stops_from, rows are computed on
+  // thread_count threads, the calling one included. nullopt if some stop is
+  // unknown.
+  std::optional<RouteMatrix> ComputeRouteMatrix(
+      const std::vector<std::string>& stops_from,
+      const std::vector<std::string>& stops_to,
+      size_t thread_count = 1) const;
 
   std::string RenderMap() const;
 
+  // Adds sizes of responses and of routing to the profiler report
+  void ReportMemoryUsage() const;
+
  private:
-  static int ComputeRoadRouteLength(const std::vector<std::string>& stops,
-                                    const Descriptions::StopsDict& stops_dict);
+  TransportCatalog() = default;
+
+  std::optional<std::vector<Descriptions::StopId>> FindStopIds(
+      const std::vector<std::string>& names) const;
+
+  // Computes responses of buses from first_bus_id on and adds the buses to
+  // responses of their stops
+  void AddBusResponses(Descriptions::BusId first_bus_id);
+
+  static int ComputeRoadRouteLength(
+      const std::vector<Descriptions::StopId>& stops,
+      const Descriptions::RoadDistances& road_distances);
 
+  // distances is a buffer reused between buses
   static double ComputeGeoRouteDistance(
-      const std::vector<std::string>& stops,
-      const Descriptions::StopsDict& stops_dict);
+      const std::vector<Descriptions::StopId>& stops,
+      const Sphere::UnitVectors& stop_vectors,
+      std::vector<double>& distances);
 
-  std::unordered_map<std::string, Stop> stops_;
-  std::unordered_map<std::string, Bus> buses_;
+  // Declared first to be unmapped after everything which points into it
+  std::unique_ptr<Serialization::MappedFile> snapshot_;
+  size_t thread_count_ = 1;  // kept for updates
+  Descriptions::Input descriptions_;  // kept for updates
+  std::vector<Stop> stops_;  // indexed by StopId
+  std::vector<Bus> buses_;   // indexed by BusId
+  StopIndex stop_index_;
   std::unique_ptr<TransportRouter> router_;
+  std::unique_ptr<RouteCache> route_cache_;  // null unless enabled
 };
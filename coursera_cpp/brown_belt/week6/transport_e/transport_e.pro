@@ -6,22 +6,50 @@ CONFIG -= qt
 SOURCES += \
     main.cpp \
     descriptions.cpp \
+    descriptions_test.cpp \
     json.cpp \
+    json_test.cpp \
+    profiler.cpp \
+    raptor_router.cpp \
     requests.cpp \
+    route_cache.cpp \
+    route_cache_test.cpp \
+    router_test.cpp \
+    serialization.cpp \
     sphere.cpp \
+    stop_index.cpp \
+    stop_index_test.cpp \
     transport_catalog.cpp \
     transport_router.cpp \
+    transport_router_test.cpp \
     utils.cpp
 
 HEADERS += \
+    barrier.h \
+    blocked_floyd_warshall_router.h \
+    contraction_hierarchies_router.h \
     descriptions.h \
+    descriptions_test.h \
+    dijkstra_router.h \
     graph.h \
+    irouter.h \
     json.h \
+    json_test.h \
+    name_registry.h \
+    profiler.h \
+    raptor_router.h \
     requests.h \
+    route_cache.h \
+    route_cache_test.h \
     router.h \
+    router_test.h \
+    serialization.h \
     sphere.h \
+    stop_index.h \
+    stop_index_test.h \
     transport_catalog.h \
     transport_router.h \
+    transport_router_test.h \
     utils.h
 
 unix:!macx: LIBS += -L$$OUT_PWD/../../brown_belt_lib/ -lbrown_belt_lib
@@ -1,122 +1,551 @@
 #include "transport_router.h"
+#include "blocked_floyd_warshall_router.h"
+#include "contraction_hierarchies_router.h"
+#include "dijkstra_router.h"
+#include "profiler.h"
+#include "router.h"
+#include "utils.h"
+
+#include <cassert>
+#include <stdexcept>
 
 using namespace std;
 
-TransportRouter::TransportRouter(const Descriptions::StopsDict& stops_dict,
-                                 const Descriptions::BusesDict& buses_dict,
-                                 const Json::Dict& routing_settings_json)
-    : routing_settings_(MakeRoutingSettings(routing_settings_json)) {
-  const size_t vertex_count = stops_dict.size() * 2;
-  vertices_info_.resize(vertex_count);
-  graph_ = BusGraph(vertex_count);
+// Fewer aren't worth a thread
+const size_t MIN_BUSES_PER_THREAD = 16;
+
+TransportRouter::TransportRouter(
+    const vector<Descriptions::Stop>& stops,
+    const vector<Descriptions::Bus>& buses,
+    const Descriptions::RoadDistances& road_distances,
+    const Json::Dict& routing_settings_json,
+    size_t thread_count)
+    : TransportRouter(stops,
+                      buses,
+                      road_distances,
+                      MakeRoutingSettings(routing_settings_json),
+                      thread_count) {}
+
+TransportRouter::TransportRouter(
+    const vector<Descriptions::Stop>& stops,
+    const vector<Descriptions::Bus>& buses,
+    const Descriptions::RoadDistances& road_distances,
+    const RoutingSettings& routing_settings,
+    size_t thread_count)
+    : routing_settings_(routing_settings), thread_count_(thread_count) {
+  if (routing_settings_.router_type == RouterType::RAPTOR) {
+    LOG_PHASE("router_precompute");
+    raptor_router_ = make_unique<RaptorRouter>(
+        stops, buses, road_distances, routing_settings_.bus_wait_time,
+        routing_settings_.bus_velocity);
+    return;
+  }
+
+  {
+    LOG_PHASE("routing_graph");
+    AddStops(stops, 0);
+    AddBuses(buses, road_distances, 0);
+    graph_.Freeze();
+  }
+
+  LOG_PHASE("router_precompute");
+  router_ = MakeRouter();
+}
+
+TransportRouter::TransportRouter(Serialization::Reader& reader,
+                                 size_t thread_count)
+    : routing_settings_(ReadRoutingSettings(reader)),
+      thread_count_(thread_count),
+      graph_(reader.Read<uint64_t>()) {
+  for (const auto& edge : reader.ReadArray<Graph::Edge<double>>()) {
+    graph_.AddEdge(edge);
+  }
+  graph_.Freeze();
+
+  const auto stops_vertex_ids = reader.ReadArray<StopVertexIds>();
+  stops_vertex_ids_.assign(stops_vertex_ids.begin(), stops_vertex_ids.end());
+
+  const auto vertices_info = reader.ReadArray<VertexInfo>();
+  vertices_info_.assign(vertices_info.begin(), vertices_info.end());
+
+  edges_info_.reserve(graph_.GetEdgeCount());
+  for (size_t edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    edges_info_.push_back(ReadEdgeInfo(reader));
+  }
+
+  if (routing_settings_.router_type == RouterType::RAPTOR) {
+    raptor_router_ = make_unique<RaptorRouter>(reader);
+  } else {
+    router_ = LoadRouter(reader);
+  }
+}
+
+void TransportRouter::AddStopsAndBuses(
+    const vector<Descriptions::Stop>& stops,
+    const vector<Descriptions::Bus>& buses,
+    const Descriptions::RoadDistances& road_distances,
+    Descriptions::StopId first_new_stop_id,
+    Descriptions::BusId first_new_bus_id) {
+  // Takes a linear pass over routes, nothing to gain from updating in place
+  if (raptor_router_) {
+    LOG_PHASE("router_precompute");
+    raptor_router_ = make_unique<RaptorRouter>(
+        stops, buses, road_distances, routing_settings_.bus_wait_time,
+        routing_settings_.bus_velocity);
+    return;
+  }
+
+  const Graph::EdgeId first_new_edge = graph_.GetEdgeCount();
+  {
+    LOG_PHASE("routing_graph");
+    graph_.Unfreeze();
+    AddStops(stops, first_new_stop_id);
+    AddBuses(buses, road_distances, first_new_bus_id);
+    graph_.Freeze();
+  }
+
+  LOG_PHASE("router_precompute");
+  if (!router_->AddEdges(first_new_edge)) {
+    router_ = MakeRouter();
+  }
+}
+
+unique_ptr<TransportRouter> TransportRouter::Rebuild(
+    const vector<Descriptions::Stop>& stops,
+    const vector<Descriptions::Bus>& buses,
+    const Descriptions::RoadDistances& road_distances) const {
+  return unique_ptr<TransportRouter>(new TransportRouter(
+      stops, buses, road_distances, routing_settings_, thread_count_));
+}
+
+void TransportRouter::ReportMemoryUsage() const {
+  Profiler::AddContainer(
+      "vertices", graph_.GetVertexCount(),
+      GetCapacityBytes(vertices_info_) + GetCapacityBytes(stops_vertex_ids_));
+  Profiler::AddContainer("edges", graph_.GetEdgeCount(),
+                         graph_.ComputeMemoryUsage());
+  Profiler::AddContainer("edges_info", edges_info_.size(),
+                         GetCapacityBytes(edges_info_));
+  Profiler::AddContainer("routing_table",
+                         raptor_router_ ? raptor_router_->ComputeMemoryUsage()
+                                        : router_->ComputeMemoryUsage());
+}
+
+void TransportRouter::Serialize(Serialization::Writer& writer) const {
+  WriteRoutingSettings(routing_settings_, writer);
 
-  FillGraphWithStops(stops_dict);
-  FillGraphWithBuses(stops_dict, buses_dict);
+  writer.Write(static_cast<uint64_t>(graph_.GetVertexCount()));
+  writer.StartArray<Graph::Edge<double>>(graph_.GetEdgeCount());
+  for (size_t edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+    writer.Write(graph_.GetEdge(edge_id));
+  }
+
+  writer.WriteArray(stops_vertex_ids_.data(), stops_vertex_ids_.size());
+  writer.WriteArray(vertices_info_.data(), vertices_info_.size());
+
+  for (const auto& edge_info : edges_info_) {
+    WriteEdgeInfo(edge_info, writer);
+  }
+
+  if (raptor_router_) {
+    raptor_router_->Serialize(writer);
+  } else {
+    router_->Serialize(writer);
+  }
+}
+
+// Every edge info is its variant index followed by the fields of the
+// alternative, if it has any
+void TransportRouter::WriteEdgeInfo(const EdgeInfo& edge_info,
+                                    Serialization::Writer& writer) {
+  writer.Write(static_cast<uint8_t>(edge_info.index()));
+  if (const auto* bus_info = get_if<BusEdgeInfo>(&edge_info)) {
+    writer.Write(bus_info->bus_id);
+    writer.Write(static_cast<uint64_t>(bus_info->span_count));
+  } else if (const auto* board_info = get_if<BoardEdgeInfo>(&edge_info)) {
+    writer.Write(board_info->bus_id);
+  }
+}
 
-  router_ = std::make_unique<Router>(graph_);
+TransportRouter::EdgeInfo TransportRouter::ReadEdgeInfo(
+    Serialization::Reader& reader) {
+  switch (reader.Read<uint8_t>()) {
+    case 0:
+      return BusEdgeInfo{
+          .bus_id = reader.Read<Descriptions::BusId>(),
+          .span_count = reader.Read<uint64_t>(),
+      };
+    case 1:
+      return WaitEdgeInfo{};
+    case 2:
+      return BoardEdgeInfo{.bus_id = reader.Read<Descriptions::BusId>()};
+    case 3:
+      return HopEdgeInfo{};
+    case 4:
+      return AlightEdgeInfo{};
+  }
+  throw runtime_error("unknown edge info in snapshot");
 }
 
 TransportRouter::RoutingSettings TransportRouter::MakeRoutingSettings(
     const Json::Dict& json) {
-  return {
+  RoutingSettings settings = {
       json.at("bus_wait_time").AsInt(),
       json.at("bus_velocity").AsDouble(),
   };
+  if (json.count("router") > 0) {
+    settings.router_type = ParseRouterType(json.at("router").AsString());
+  }
+  if (json.count("router_cache_mb") > 0) {
+    settings.router_cache_mb = json.at("router_cache_mb").AsInt();
+  }
+  if (json.count("graph_model") > 0) {
+    settings.graph_model = ParseGraphModel(json.at("graph_model").AsString());
+  }
+  return settings;
+}
+
+void TransportRouter::WriteRoutingSettings(const RoutingSettings& settings,
+                                           Serialization::Writer& writer) {
+  writer.Write(static_cast<int32_t>(settings.bus_wait_time));
+  writer.Write(settings.bus_velocity);
+  writer.Write(static_cast<uint8_t>(settings.router_type));
+  writer.Write(static_cast<uint64_t>(settings.router_cache_mb));
+  writer.Write(static_cast<uint8_t>(settings.graph_model));
 }
 
-void TransportRouter::FillGraphWithStops(
-    const Descriptions::StopsDict& stops_dict) {
-  Graph::VertexId vertex_id = 0;
+TransportRouter::RoutingSettings TransportRouter::ReadRoutingSettings(
+    Serialization::Reader& reader) {
+  // Initializers of a braced list are evaluated in order
+  return {
+      .bus_wait_time = reader.Read<int32_t>(),
+      .bus_velocity = reader.Read<double>(),
+      .router_type = static_cast<RouterType>(reader.Read<uint8_t>()),
+      .router_cache_mb = reader.Read<uint64_t>(),
+      .graph_model = static_cast<GraphModel>(reader.Read<uint8_t>()),
+  };
+}
+
+TransportRouter::RouterType TransportRouter::ParseRouterType(string_view name) {
+  if (name == "floyd_warshall") {
+    return RouterType::FLOYD_WARSHALL;
+  } else if (name == "blocked_floyd_warshall") {
+    return RouterType::BLOCKED_FLOYD_WARSHALL;
+  } else if (name == "dijkstra") {
+    return RouterType::DIJKSTRA;
+  } else if (name == "contraction_hierarchies") {
+    return RouterType::CONTRACTION_HIERARCHIES;
+  } else if (name == "raptor") {
+    return RouterType::RAPTOR;
+  }
+  throw invalid_argument("unknown router: " + string(name));
+}
 
-  for (const auto& [stop_name, _] : stops_dict) {
-    auto& vertex_ids = stops_vertex_ids_[stop_name];
-    vertex_ids.in = vertex_id++;
-    vertex_ids.out = vertex_id++;
-    vertices_info_[vertex_ids.in] = {stop_name};
-    vertices_info_[vertex_ids.out] = {stop_name};
+TransportRouter::GraphModel TransportRouter::ParseGraphModel(string_view name) {
+  if (name == "stops") {
+    return GraphModel::STOPS;
+  } else if (name == "compact") {
+    return GraphModel::COMPACT;
+  }
+  throw invalid_argument("unknown graph model: " + string(name));
+}
 
-    edges_info_.push_back(WaitEdgeInfo{});
-    const Graph::EdgeId edge_id =
-        graph_.AddEdge({vertex_ids.out, vertex_ids.in,
-                        static_cast<double>(routing_settings_.bus_wait_time)});
-    assert(edge_id == edges_info_.size() - 1);
+unique_ptr<TransportRouter::Router> TransportRouter::MakeRouter() const {
+  switch (routing_settings_.router_type) {
+    case RouterType::FLOYD_WARSHALL:
+      return make_unique<Graph::Router<double>>(graph_);
+    case RouterType::BLOCKED_FLOYD_WARSHALL:
+      return make_unique<Graph::BlockedFloydWarshallRouter<double>>(
+          graph_, thread_count_);
+    case RouterType::DIJKSTRA:
+      return make_unique<Graph::DijkstraRouter<double>>(
+          graph_, routing_settings_.router_cache_mb << 20);
+    case RouterType::CONTRACTION_HIERARCHIES:
+      return make_unique<Graph::ContractionHierarchiesRouter<double>>(graph_);
+    case RouterType::RAPTOR:
+      break;
   }
+  return nullptr;
+}
 
-  assert(vertex_id == graph_.GetVertexCount());
+unique_ptr<TransportRouter::Router> TransportRouter::LoadRouter(
+    Serialization::Reader& reader) const {
+  switch (routing_settings_.router_type) {
+    case RouterType::FLOYD_WARSHALL:
+    case RouterType::BLOCKED_FLOYD_WARSHALL:
+      return make_unique<Graph::BlockedFloydWarshallRouter<double>>(
+          graph_, reader, thread_count_);
+    case RouterType::CONTRACTION_HIERARCHIES:
+      return make_unique<Graph::ContractionHierarchiesRouter<double>>(graph_,
+                                                                      reader);
+    case RouterType::DIJKSTRA:
+    case RouterType::RAPTOR:
+      return MakeRouter();
+  }
+  return nullptr;
 }
 
-void TransportRouter::FillGraphWithBuses(
-    const Descriptions::StopsDict& stops_dict,
-    const Descriptions::BusesDict& buses_dict) {
-  for (const auto& [_, bus_item] : buses_dict) {
-    const auto& bus = *bus_item;
-    const size_t stop_count = bus.stops.size();
-    if (stop_count <= 1) {
-      continue;
+void TransportRouter::AddStops(const vector<Descriptions::Stop>& stops,
+                               Descriptions::StopId first_stop_id) {
+  // The stops model has an in and an out vertex per stop with the wait in
+  // between, the compact one a single vertex
+  const size_t vertices_per_stop =
+      routing_settings_.graph_model == GraphModel::COMPACT ? 1 : 2;
+  for (size_t stop_id = first_stop_id; stop_id < stops.size(); ++stop_id) {
+    assert(stops_vertex_ids_.size() == stop_id);
+    const Graph::VertexId in = graph_.AddVertices(vertices_per_stop);
+    const Graph::VertexId out = in + vertices_per_stop - 1;
+    stops_vertex_ids_.push_back({in, out});
+    vertices_info_.resize(graph_.GetVertexCount(), {stops[stop_id].id});
+    if (in != out) {
+      AddEdge({out, in, static_cast<double>(routing_settings_.bus_wait_time)},
+              WaitEdgeInfo{});
     }
-    auto compute_distance_from = [&stops_dict, &bus](size_t lhs_idx) {
-      return Descriptions::ComputeStopsDistance(
-          *stops_dict.at(bus.stops[lhs_idx]),
-          *stops_dict.at(bus.stops[lhs_idx + 1]));
-    };
-    for (size_t start_stop_idx = 0; start_stop_idx + 1 < stop_count;
-         ++start_stop_idx) {
-      const Graph::VertexId start_vertex =
-          stops_vertex_ids_[bus.stops[start_stop_idx]].in;
-      int total_distance = 0;
-      for (size_t finish_stop_idx = start_stop_idx + 1;
-           finish_stop_idx < stop_count; ++finish_stop_idx) {
-        total_distance += compute_distance_from(finish_stop_idx - 1);
-        edges_info_.push_back(BusEdgeInfo{
-            .bus_name = bus.name,
-            .span_count = finish_stop_idx - start_stop_idx,
-        });
-        const Graph::EdgeId edge_id = graph_.AddEdge({
-            start_vertex, stops_vertex_ids_[bus.stops[finish_stop_idx]].out,
-            total_distance * 1.0 /
-                (routing_settings_.bus_velocity * 1000.0 /
-                 60)  // m / (km/h * 1000 / 60) = min
-        });
-        assert(edge_id == edges_info_.size() - 1);
+  }
+}
+
+void TransportRouter::AddBuses(
+    const vector<Descriptions::Bus>& buses,
+    const Descriptions::RoadDistances& road_distances,
+    Descriptions::BusId first_bus_id) {
+  const bool is_compact = routing_settings_.graph_model == GraphModel::COMPACT;
+
+  // Ride vertices go first, so that edges of each bus can be built apart
+  vector<Graph::VertexId> first_ride_vertices(buses.size() - first_bus_id);
+  if (is_compact) {
+    for (size_t bus_id = first_bus_id; bus_id < buses.size(); ++bus_id) {
+      const auto& bus_stops = buses[bus_id].stops;
+      if (bus_stops.size() <= 1) {
+        continue;
+      }
+      first_ride_vertices[bus_id - first_bus_id] =
+          graph_.AddVertices(bus_stops.size());
+      for (const Descriptions::StopId stop_id : bus_stops) {
+        vertices_info_.push_back({stop_id});
       }
     }
+    assert(vertices_info_.size() == graph_.GetVertexCount());
+  }
+
+  const auto edge_buffers = ProcessInParallel(
+      buses.size() - first_bus_id, MIN_BUSES_PER_THREAD, thread_count_,
+      [&](size_t part_begin, size_t part_end) {
+        EdgeBuffer edge_buffer;
+        size_t edge_count = 0;
+        for (size_t bus_idx = part_begin; bus_idx < part_end; ++bus_idx) {
+          edge_count += CountBusEdges(buses[first_bus_id + bus_idx]);
+        }
+        edge_buffer.edges.reserve(edge_count);
+        edge_buffer.edges_info.reserve(edge_count);
+
+        for (size_t bus_idx = part_begin; bus_idx < part_end; ++bus_idx) {
+          const auto& bus = buses[first_bus_id + bus_idx];
+          if (bus.stops.size() <= 1) {
+            continue;
+          }
+          if (is_compact) {
+            AddCompactBusEdges(road_distances, bus,
+                               first_ride_vertices[bus_idx], edge_buffer);
+          } else {
+            AddBusEdges(road_distances, bus, edge_buffer);
+          }
+        }
+        return edge_buffer;
+      });
+
+  // Buffers go in the order of buses, so edge ids don't depend on threads
+  size_t edge_count = edges_info_.size();
+  for (const auto& edge_buffer : edge_buffers) {
+    edge_count += edge_buffer.edges.size();
+  }
+  edges_info_.reserve(edge_count);
+  graph_.ReserveEdges(edge_count);
+  for (const auto& edge_buffer : edge_buffers) {
+    for (size_t edge_idx = 0; edge_idx < edge_buffer.edges.size();
+         ++edge_idx) {
+      AddEdge(edge_buffer.edges[edge_idx], edge_buffer.edges_info[edge_idx]);
+    }
+  }
+}
+
+size_t TransportRouter::CountBusEdges(const Descriptions::Bus& bus) const {
+  const size_t stop_count = bus.stops.size();
+  if (stop_count <= 1) {
+    return 0;
+  }
+  // A board, a hop and an alight per span, or an edge per pair of stops
+  return routing_settings_.graph_model == GraphModel::COMPACT
+             ? 3 * (stop_count - 1)
+             : stop_count * (stop_count - 1) / 2;
+}
+
+void TransportRouter::AddBusEdges(
+    const Descriptions::RoadDistances& road_distances,
+    const Descriptions::Bus& bus,
+    EdgeBuffer& edge_buffer) const {
+  const size_t stop_count = bus.stops.size();
+  auto compute_distance_from = [&road_distances, &bus](size_t lhs_idx) {
+    return road_distances.Get(bus.stops[lhs_idx], bus.stops[lhs_idx + 1]);
+  };
+  for (size_t start_stop_idx = 0; start_stop_idx + 1 < stop_count;
+       ++start_stop_idx) {
+    const Graph::VertexId start_vertex =
+        stops_vertex_ids_[bus.stops[start_stop_idx]].in;
+    int total_distance = 0;
+    for (size_t finish_stop_idx = start_stop_idx + 1;
+         finish_stop_idx < stop_count; ++finish_stop_idx) {
+      total_distance += compute_distance_from(finish_stop_idx - 1);
+      edge_buffer.Add(
+          {start_vertex, stops_vertex_ids_[bus.stops[finish_stop_idx]].out,
+           ComputeRideTime(total_distance)},
+          BusEdgeInfo{
+              .bus_id = bus.id,
+              .span_count = finish_stop_idx - start_stop_idx,
+          });
+    }
+  }
+}
+
+void TransportRouter::AddCompactBusEdges(
+    const Descriptions::RoadDistances& road_distances,
+    const Descriptions::Bus& bus,
+    Graph::VertexId first_ride_vertex,
+    EdgeBuffer& edge_buffer) const {
+  const size_t stop_count = bus.stops.size();
+  for (size_t stop_idx = 0; stop_idx < stop_count; ++stop_idx) {
+    const Descriptions::StopId stop_id = bus.stops[stop_idx];
+    const Graph::VertexId stop_vertex = stops_vertex_ids_[stop_id].in;
+    const Graph::VertexId ride_vertex = first_ride_vertex + stop_idx;
+    if (stop_idx + 1 < stop_count) {
+      edge_buffer.Add({stop_vertex, ride_vertex,
+                       static_cast<double>(routing_settings_.bus_wait_time)},
+                      BoardEdgeInfo{bus.id});
+      edge_buffer.Add(
+          {ride_vertex, ride_vertex + 1,
+           ComputeRideTime(
+               road_distances.Get(stop_id, bus.stops[stop_idx + 1]))},
+          HopEdgeInfo{});
+    }
+    if (stop_idx > 0) {
+      edge_buffer.Add({ride_vertex, stop_vertex, 0}, AlightEdgeInfo{});
+    }
   }
 }
 
+double TransportRouter::ComputeRideTime(int distance) const {
+  // m / (km/h * 1000 / 60) = min
+  return distance * 1.0 / (routing_settings_.bus_velocity * 1000.0 / 60);
+}
+
+Graph::EdgeId TransportRouter::AddEdge(const Graph::Edge<double>& edge,
+                                       EdgeInfo edge_info) {
+  edges_info_.push_back(edge_info);
+  const Graph::EdgeId edge_id = graph_.AddEdge(edge);
+  assert(edge_id == edges_info_.size() - 1);
+  return edge_id;
+}
+
 optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(
-    const string& stop_from,
-    const string& stop_to) const {
+    Descriptions::StopId stop_from,
+    Descriptions::StopId stop_to) const {
+  if (raptor_router_) {
+    const auto journey = raptor_router_->FindJourney(stop_from, stop_to);
+    if (!journey) {
+      return nullopt;
+    }
+    return MakeRouteInfo(*journey);
+  }
+
   const Graph::VertexId vertex_from = stops_vertex_ids_.at(stop_from).out;
   const Graph::VertexId vertex_to = stops_vertex_ids_.at(stop_to).out;
-  const auto route = router_->BuildRoute(vertex_from, vertex_to);
-  if (!route) {
+  // Each thread keeps its buffer, so only the response items get allocated
+  thread_local vector<Graph::EdgeId> route_edges;
+  if (!router_->WriteRoute(vertex_from, vertex_to, route_edges)) {
     return nullopt;
   }
 
-  RouteInfo route_info = {.total_time = route->weight};
-  route_info.items.reserve(route->edge_count);
-  for (size_t edge_idx = 0; edge_idx < route->edge_count; ++edge_idx) {
-    const Graph::EdgeId edge_id = router_->GetRouteEdge(route->id, edge_idx);
+  // The total is summed from the items, so that it matches them exactly
+  RouteInfo route_info = {.total_time = 0, .items = {}};
+  route_info.items.reserve(route_edges.size());
+  for (const Graph::EdgeId edge_id : route_edges) {
     const auto& edge = graph_.GetEdge(edge_id);
     const auto& edge_info = edges_info_[edge_id];
     if (holds_alternative<BusEdgeInfo>(edge_info)) {
       const BusEdgeInfo& bus_edge_info = get<BusEdgeInfo>(edge_info);
       route_info.items.push_back(RouteInfo::BusItem{
-          .bus_name = bus_edge_info.bus_name,
+          .bus_id = bus_edge_info.bus_id,
           .time = edge.weight,
           .span_count = bus_edge_info.span_count,
       });
-    } else {
+    } else if (holds_alternative<WaitEdgeInfo>(edge_info)) {
       const Graph::VertexId vertex_id = edge.from;
       route_info.items.push_back(RouteInfo::WaitItem{
-          .stop_name = vertices_info_[vertex_id].stop_name,
+          .stop_id = vertices_info_[vertex_id].stop_id,
+          .time = edge.weight,
+      });
+    } else if (holds_alternative<BoardEdgeInfo>(edge_info)) {
+      // Boarding stands for the wait and opens a ride, which the following
+      // hops extend
+      route_info.items.push_back(RouteInfo::WaitItem{
+          .stop_id = vertices_info_[edge.from].stop_id,
           .time = edge.weight,
       });
+      route_info.items.push_back(RouteInfo::BusItem{
+          .bus_id = get<BoardEdgeInfo>(edge_info).bus_id,
+          .time = 0,
+          .span_count = 0,
+      });
+    } else if (holds_alternative<HopEdgeInfo>(edge_info)) {
+      auto& bus_item = get<RouteInfo::BusItem>(route_info.items.back());
+      bus_item.time += edge.weight;
+      ++bus_item.span_count;
+    } else if (holds_alternative<AlightEdgeInfo>(edge_info)) {
+      // With no wait time a ride may end where it started, which is no ride
+      // at all, so it goes together with its wait
+      if (get<RouteInfo::BusItem>(route_info.items.back()).span_count == 0) {
+        route_info.items.pop_back();
+        route_info.items.pop_back();
+      }
     }
   }
 
-  // Releasing in destructor of some proxy object would be better,
-  // but we do not expect exceptions in normal workflow
-  router_->ReleaseRoute(route->id);
+  for (const auto& item : route_info.items) {
+    route_info.total_time +=
+        visit([](const auto& typed_item) { return typed_item.time; }, item);
+  }
   return route_info;
 }
+
+TransportRouter::RouteInfo TransportRouter::MakeRouteInfo(
+    const RaptorRouter::Journey& journey) const {
+  RouteInfo route_info = {.total_time = journey.total_time, .items = {}};
+  route_info.items.reserve(journey.legs.size() * 2);
+  for (const auto& leg : journey.legs) {
+    route_info.items.push_back(RouteInfo::WaitItem{
+        .stop_id = leg.board_stop_id,
+        .time = raptor_router_->GetWaitTime(),
+    });
+    route_info.items.push_back(RouteInfo::BusItem{
+        .bus_id = leg.bus_id,
+        .time = leg.ride_time,
+        .span_count = leg.span_count,
+    });
+  }
+  return route_info;
+}
+
+TransportRouter::TotalTimes TransportRouter::ComputeTotalTimes(
+    Descriptions::StopId stop_from,
+    const vector<Descriptions::StopId>& stops_to) const {
+  if (raptor_router_) {
+    return raptor_router_->ComputeTotalTimes(stop_from, stops_to);
+  }
+
+  vector<Graph::VertexId> vertices_to;
+  vertices_to.reserve(stops_to.size());
+  for (const auto stop_id : stops_to) {
+    vertices_to.push_back(stops_vertex_ids_.at(stop_id).out);
+  }
+  return router_->ComputeRouteWeights(stops_vertex_ids_.at(stop_from).out,
+                                      vertices_to);
+}
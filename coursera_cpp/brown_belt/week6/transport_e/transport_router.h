@@ -2,33 +2,62 @@
 
 #include "descriptions.h"
 #include "graph.h"
+#include "irouter.h"
 #include "json.h"
-#include "router.h"
+#include "raptor_router.h"
+#include "serialization.h"
 
 #include <memory>
-#include <unordered_map>
+#include <string_view>
+#include <variant>
 #include <vector>
 
 class TransportRouter {
  private:
   using BusGraph = Graph::DirectedWeightedGraph<double>;
-  using Router = Graph::Router<double>;
+  using Router = Graph::IRouter<double>;
 
  public:
-  TransportRouter(const Descriptions::StopsDict& stops_dict,
-                  const Descriptions::BusesDict& buses_dict,
-                  const Json::Dict& routing_settings_json);
+  // Routing tables which support it are computed on thread_count threads
+  TransportRouter(const std::vector<Descriptions::Stop>& stops,
+                  const std::vector<Descriptions::Bus>& buses,
+                  const Descriptions::RoadDistances& road_distances,
+                  const Json::Dict& routing_settings_json,
+                  size_t thread_count = 1);
+  explicit TransportRouter(Serialization::Reader& reader,
+                           size_t thread_count = 1);
+
+  void Serialize(Serialization::Writer& writer) const;
+
+  // Adds sizes of the graph and of routing tables to the profiler report
+  void ReportMemoryUsage() const;
+
+  // Catches up with stops and buses appended to the descriptions from the
+  // given ids on: the graph gets their vertices and edges, and routers
+  // which can't take new edges in place are built anew. Not safe to call
+  // concurrently with queries.
+  void AddStopsAndBuses(const std::vector<Descriptions::Stop>& stops,
+                        const std::vector<Descriptions::Bus>& buses,
+                        const Descriptions::RoadDistances& road_distances,
+                        Descriptions::StopId first_new_stop_id,
+                        Descriptions::BusId first_new_bus_id);
+
+  // A router with the same settings over other descriptions
+  std::unique_ptr<TransportRouter> Rebuild(
+      const std::vector<Descriptions::Stop>& stops,
+      const std::vector<Descriptions::Bus>& buses,
+      const Descriptions::RoadDistances& road_distances) const;
 
   struct RouteInfo {
     double total_time;
 
     struct BusItem {
-      std::string bus_name;
+      Descriptions::BusId bus_id;
       double time;
       size_t span_count;
     };
     struct WaitItem {
-      std::string stop_name;
+      Descriptions::StopId stop_id;
       double time;
     };
 
@@ -36,41 +65,131 @@ class TransportRouter {
     std::vector<Item> items;
   };
 
-  std::optional<RouteInfo> FindRoute(const std::string& stop_from,
-                                     const std::string& stop_to) const;
+  std::optional<RouteInfo> FindRoute(Descriptions::StopId stop_from,
+                                     Descriptions::StopId stop_to) const;
+
+  using TotalTimes = std::vector<std::optional<double>>;
+
+  // Total times of routes from one stop to each of stops_to, without
+  // building route items
+  TotalTimes ComputeTotalTimes(
+      Descriptions::StopId stop_from,
+      const std::vector<Descriptions::StopId>& stops_to) const;
 
  private:
+  enum class RouterType {
+    FLOYD_WARSHALL,
+    BLOCKED_FLOYD_WARSHALL,
+    DIJKSTRA,
+    CONTRACTION_HIERARCHIES,
+    RAPTOR,  // runs over bus routes, no graph is built
+  };
+
+  // STOPS has in and out vertices per stop and an edge from every stop of a
+  // bus to every later one. COMPACT has a vertex per stop and a ride vertex
+  // per stop of every bus, chained by hops, so edges grow linearly.
+  enum class GraphModel {
+    STOPS,
+    COMPACT,
+  };
+
   struct RoutingSettings {
     int bus_wait_time;    // in minutes
     double bus_velocity;  // km/h
+    RouterType router_type = RouterType::FLOYD_WARSHALL;
+    size_t router_cache_mb = 256;  // memory budget of on-demand routers
+    GraphModel graph_model = GraphModel::STOPS;
   };
 
+  TransportRouter(const std::vector<Descriptions::Stop>& stops,
+                  const std::vector<Descriptions::Bus>& buses,
+                  const Descriptions::RoadDistances& road_distances,
+                  const RoutingSettings& routing_settings,
+                  size_t thread_count);
+
   static RoutingSettings MakeRoutingSettings(const Json::Dict& json);
+  // Field by field, so padding of the struct doesn't go to snapshots
+  static void WriteRoutingSettings(const RoutingSettings& settings,
+                                   Serialization::Writer& writer);
+  static RoutingSettings ReadRoutingSettings(Serialization::Reader& reader);
 
-  void FillGraphWithStops(const Descriptions::StopsDict& stops_dict);
+  static RouterType ParseRouterType(std::string_view name);
+  static GraphModel ParseGraphModel(std::string_view name);
 
-  void FillGraphWithBuses(const Descriptions::StopsDict& stops_dict,
-                          const Descriptions::BusesDict& buses_dict);
+  std::unique_ptr<Router> MakeRouter() const;
+  std::unique_ptr<Router> LoadRouter(Serialization::Reader& reader) const;
+
+  RouteInfo MakeRouteInfo(const RaptorRouter::Journey& journey) const;
+
+  // Add vertices and edges of stops and buses from the given ids on
+  void AddStops(const std::vector<Descriptions::Stop>& stops,
+                Descriptions::StopId first_stop_id);
+  void AddBuses(const std::vector<Descriptions::Bus>& buses,
+                const Descriptions::RoadDistances& road_distances,
+                Descriptions::BusId first_bus_id);
 
   struct StopVertexIds {
     Graph::VertexId in;
     Graph::VertexId out;
   };
   struct VertexInfo {
-    std::string stop_name;
+    Descriptions::StopId stop_id;
   };
 
   struct BusEdgeInfo {
-    std::string bus_name;
+    Descriptions::BusId bus_id;
     size_t span_count;
   };
   struct WaitEdgeInfo {};
-  using EdgeInfo = std::variant<BusEdgeInfo, WaitEdgeInfo>;
+  // Edges of the compact model: a ride starts with boarding, which takes
+  // the wait time, goes on with hops to next stops and ends with alighting
+  struct BoardEdgeInfo {
+    Descriptions::BusId bus_id;
+  };
+  struct HopEdgeInfo {};
+  struct AlightEdgeInfo {};
+  using EdgeInfo = std::variant<BusEdgeInfo,
+                                WaitEdgeInfo,
+                                BoardEdgeInfo,
+                                HopEdgeInfo,
+                                AlightEdgeInfo>;
+
+  static void WriteEdgeInfo(const EdgeInfo& edge_info,
+                            Serialization::Writer& writer);
+  static EdgeInfo ReadEdgeInfo(Serialization::Reader& reader);
+
+  double ComputeRideTime(int distance) const;
+
+  Graph::EdgeId AddEdge(const Graph::Edge<double>& edge, EdgeInfo edge_info);
+
+  // Edges of a part of buses, built on a thread of its own and added to the
+  // graph afterwards
+  struct EdgeBuffer {
+    std::vector<Graph::Edge<double>> edges;
+    std::vector<EdgeInfo> edges_info;
+
+    void Add(const Graph::Edge<double>& edge, EdgeInfo edge_info) {
+      edges.push_back(edge);
+      edges_info.push_back(edge_info);
+    }
+  };
+
+  size_t CountBusEdges(const Descriptions::Bus& bus) const;
+  void AddBusEdges(const Descriptions::RoadDistances& road_distances,
+                   const Descriptions::Bus& bus,
+                   EdgeBuffer& edge_buffer) const;
+  // Ride vertices of the bus go from first_ride_vertex on
+  void AddCompactBusEdges(const Descriptions::RoadDistances& road_distances,
+                          const Descriptions::Bus& bus,
+                          Graph::VertexId first_ride_vertex,
+                          EdgeBuffer& edge_buffer) const;
 
   RoutingSettings routing_settings_;
+  size_t thread_count_;  // comes with the input, not from snapshots
   BusGraph graph_;
   std::unique_ptr<Router> router_;
-  std::unordered_map<std::string, StopVertexIds> stops_vertex_ids_;
+  std::unique_ptr<RaptorRouter> raptor_router_;  // instead of the graph
+  std::vector<StopVertexIds> stops_vertex_ids_;  // indexed by StopId
   std::vector<VertexInfo> vertices_info_;
   std::vector<EdgeInfo> edges_info_;
 };
@@ -0,0 +1,157 @@
+#include "transport_router_test.h"
+#include "descriptions.h"
+#include "json.h"
+#include "test_runner.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+// Buses of random stops, road distances are given between neighbours on
+// a bus one way only, and a few stops no bus goes through
+string MakeRandomDescriptions(size_t stop_count,
+                              size_t bus_count,
+                              mt19937& generator) {
+  uniform_real_distribution<double> coordinate_distribution(0.0, 0.1);
+  uniform_int_distribution<size_t> stop_distribution(0, stop_count - 1);
+  uniform_int_distribution<size_t> bus_size_distribution(2, 8);
+  uniform_int_distribution<int> distance_distribution(100, 5000);
+
+  vector<vector<size_t>> neighbours(stop_count);
+  ostringstream output;
+  output << "[";
+  for (size_t bus_idx = 0; bus_idx < bus_count; ++bus_idx) {
+    const bool is_roundtrip = bus_idx % 2 == 0;
+    vector<size_t> stops(bus_size_distribution(generator));
+    for (size_t& stop : stops) {
+      stop = stop_distribution(generator);
+    }
+    if (is_roundtrip) {
+      stops.push_back(stops.front());
+    }
+    output << R"({"type": "Bus", "name": "bus)" << bus_idx
+           << R"(", "is_roundtrip": )" << boolalpha << is_roundtrip
+           << R"(, "stops": [)";
+    for (size_t stop_idx = 0; stop_idx < stops.size(); ++stop_idx) {
+      output << (stop_idx > 0 ? ", " : "") << "\"stop" << stops[stop_idx]
+             << "\"";
+      if (stop_idx > 0) {
+        neighbours[stops[stop_idx - 1]].push_back(stops[stop_idx]);
+      }
+    }
+    output << "]}, ";
+  }
+
+  for (size_t stop = 0; stop < stop_count; ++stop) {
+    output << R"({"type": "Stop", "name": "stop)" << stop
+           << R"(", "latitude": )" << 55 + coordinate_distribution(generator)
+           << R"(, "longitude": )" << 37 + coordinate_distribution(generator)
+           << R"(, "road_distances": {)";
+    for (size_t idx = 0; idx < neighbours[stop].size(); ++idx) {
+      output << (idx > 0 ? ", " : "") << "\"stop" << neighbours[stop][idx]
+             << "\": " << distance_distribution(generator);
+    }
+    output << "}}" << (stop + 1 < stop_count ? ", " : "");
+  }
+  output << "]";
+  return output.str();
+}
+
+bool IsClose(double lhs, double rhs) {
+  return abs(lhs - rhs) <= 1e-9 * max(abs(lhs), abs(rhs));
+}
+
+using RouteInfo = TransportRouter::RouteInfo;
+
+// Items must take turns from a wait to a ride and add up to the total time
+void CheckItems(const RouteInfo& route, const string& hint) {
+  AssertEqual(route.items.size() % 2, 0u, hint);
+  double total_time = 0;
+  for (size_t idx = 0; idx < route.items.size(); ++idx) {
+    const auto& item = route.items[idx];
+    AssertEqual(holds_alternative<RouteInfo::WaitItem>(item), idx % 2 == 0,
+                hint);
+    if (const auto* bus_item = get_if<RouteInfo::BusItem>(&item)) {
+      Assert(bus_item->span_count > 0, hint);
+      total_time += bus_item->time;
+    } else {
+      total_time += get<RouteInfo::WaitItem>(item).time;
+    }
+  }
+  Assert(IsClose(total_time, route.total_time), hint);
+}
+
+void CheckRouter(const string& router_name,
+                 const string& graph_model,
+                 const string& descriptions_text) {
+  const Json::Document descriptions_document = Json::Load(descriptions_text);
+  const Descriptions::Input input =
+      Descriptions::ReadDescriptions(descriptions_document.GetRoot().AsArray());
+
+  // Documents view the text they are loaded from
+  const string settings_prefix =
+      R"({"bus_wait_time": 6, "bus_velocity": 40, "graph_model": ")" +
+      graph_model + R"(", "router": ")";
+  const string expected_settings_text = settings_prefix + "floyd_warshall\"}";
+  const string settings_text = settings_prefix + router_name + "\"}";
+  const Json::Document expected_settings = Json::Load(expected_settings_text);
+  const Json::Document settings = Json::Load(settings_text);
+  const TransportRouter expected_router(
+      input.stops, input.buses, input.road_distances,
+      expected_settings.GetRoot().AsMap());
+  const TransportRouter router(input.stops, input.buses, input.road_distances,
+                               settings.GetRoot().AsMap());
+
+  vector<Descriptions::StopId> stops_to(input.stops.size());
+  for (Descriptions::StopId stop_id = 0; stop_id < stops_to.size();
+       ++stop_id) {
+    stops_to[stop_id] = stop_id;
+  }
+  for (Descriptions::StopId stop_from = 0; stop_from < stops_to.size();
+       ++stop_from) {
+    const auto expected_times =
+        expected_router.ComputeTotalTimes(stop_from, stops_to);
+    const auto total_times = router.ComputeTotalTimes(stop_from, stops_to);
+    for (const Descriptions::StopId stop_to : stops_to) {
+      ostringstream hint;
+      hint << router_name << ", " << graph_model << ", " << stop_from
+           << " -> " << stop_to;
+      const auto expected = expected_router.FindRoute(stop_from, stop_to);
+      const auto route = router.FindRoute(stop_from, stop_to);
+      AssertEqual(route.has_value(), expected.has_value(), hint.str());
+      AssertEqual(total_times[stop_to].has_value(), expected.has_value(),
+                  hint.str());
+      AssertEqual(expected_times[stop_to].has_value(), expected.has_value(),
+                  hint.str());
+      if (!expected) {
+        continue;
+      }
+      Assert(IsClose(route->total_time, expected->total_time), hint.str());
+      Assert(IsClose(*total_times[stop_to], expected->total_time),
+             hint.str());
+      CheckItems(*route, hint.str());
+    }
+  }
+}
+
+void TestRaptorRouter() {
+  mt19937 generator(29);
+  for (int test_idx = 0; test_idx < 5; ++test_idx) {
+    const string descriptions = MakeRandomDescriptions(40, 12, generator);
+    for (const string graph_model : {"stops", "compact"}) {
+      CheckRouter("raptor", graph_model, descriptions);
+    }
+  }
+}
+
+void RunTransportRouterTests() {
+  TestRunner tr;
+  RUN_TEST(tr, TestRaptorRouter);
+}
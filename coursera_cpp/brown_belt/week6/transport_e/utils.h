@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <future>
 #include <iterator>
 #include <string_view>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 template <typename It>
 class Range {
@@ -40,4 +45,47 @@ const V* GetValuePointer(const std::unordered_map<K, V>& map, const K& key) {
   }
 }
 
+// Bytes of the vector's own buffer, not of what its items point to
+template <typename T>
+size_t GetCapacityBytes(const std::vector<T>& items) {
+  return items.capacity() * sizeof(T);
+}
+
+// Splits [0, item_count) into contiguous parts of at least min_part_size
+// items, one per thread of thread_count, and returns what
+// process(part_begin, part_end) gives for each part in the order of parts,
+// unless it gives nothing
+template <typename Process>
+auto ProcessInParallel(size_t item_count,
+                       size_t min_part_size,
+                       size_t thread_count,
+                       Process process) {
+  using Result = std::invoke_result_t<Process, size_t, size_t>;
+  const size_t part_count = std::max<size_t>(
+      std::min<size_t>(thread_count,
+                       item_count / std::max<size_t>(min_part_size, 1)),
+      1);
+  std::vector<std::future<Result>> futures;
+  for (size_t part_idx = 1; part_idx < part_count; ++part_idx) {
+    futures.push_back(std::async(std::launch::async, process,
+                                 item_count * part_idx / part_count,
+                                 item_count * (part_idx + 1) / part_count));
+  }
+  // The first part goes on the calling thread
+  if constexpr (std::is_void_v<Result>) {
+    process(0, item_count / part_count);
+    for (auto& future : futures) {
+      future.get();
+    }
+  } else {
+    std::vector<Result> results;
+    results.reserve(part_count);
+    results.push_back(process(0, item_count / part_count));
+    for (auto& future : futures) {
+      results.push_back(future.get());
+    }
+    return results;
+  }
+}
+
 std::string_view Strip(std::string_view line);
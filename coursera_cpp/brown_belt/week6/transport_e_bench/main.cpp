@@ -0,0 +1,175 @@
+#include "descriptions.h"
+#include "json.h"
+#include "network_generator.h"
+#include "phase_benchmark.h"
+#include "profile.h"
+#include "transport_catalog.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+const size_t QUERY_COUNT = 2'000;
+
+vector<pair<string, string>> GenerateQueries(size_t stop_count) {
+  mt19937 generator(7);
+  uniform_int_distribution<size_t> stops(0, stop_count - 1);
+  vector<pair<string, string>> queries(QUERY_COUNT);
+  for (auto& [from, to] : queries) {
+    from = Bench::GetStopName(stops(generator));
+    to = Bench::GetStopName(stops(generator));
+  }
+  return queries;
+}
+
+vector<optional<double>> RunQueries(
+    const TransportCatalog& db,
+    const vector<pair<string, string>>& queries) {
+  vector<optional<double>> total_times;
+  total_times.reserve(queries.size());
+  for (const auto& [from, to] : queries) {
+    const auto route = db.FindRoute(from, to);
+    total_times.push_back(route ? optional(route->total_time) : nullopt);
+  }
+  return total_times;
+}
+
+vector<optional<double>> Benchmark(const Bench::NetworkParams& params,
+                                   const Json::Array& base_requests,
+                                   const vector<pair<string, string>>& queries,
+                                   const string& router) {
+  const string title = router + ", " + to_string(params.stop_count) +
+                       " stops, " + to_string(params.bus_count) + " buses";
+  optional<TransportCatalog> db;
+  {
+    LOG_DURATION(title + ", build");
+    db.emplace(Descriptions::ReadDescriptions(base_requests),
+               Bench::MakeRoutingSettings(router));
+  }
+  LOG_DURATION(title + ", " + to_string(queries.size()) + " routes");
+  return RunQueries(*db, queries);
+}
+
+bool AreSame(const vector<optional<double>>& lhs,
+             const vector<optional<double>>& rhs) {
+  for (size_t idx = 0; idx < lhs.size(); ++idx) {
+    if (lhs[idx].has_value() != rhs[idx].has_value() ||
+        (lhs[idx] && abs(*lhs[idx] - *rhs[idx]) > 1e-6)) {
+      return false;
+    }
+  }
+  return lhs.size() == rhs.size();
+}
+
+// Compares RAPTOR with the Floyd-Warshall router on generated networks:
+// time to build a catalog and to answer the same random route requests
+int CompareRouters() {
+  const vector<Bench::NetworkParams> networks = {
+      {.stop_count = 200, .bus_count = 40, .stops_per_bus = 20},
+      {.stop_count = 1000, .bus_count = 200, .stops_per_bus = 30},
+      {.stop_count = 2000, .bus_count = 400, .stops_per_bus = 40},
+  };
+
+  for (const auto& params : networks) {
+    const auto base_requests = Bench::GenerateBaseRequests(params);
+    const auto queries = GenerateQueries(params.stop_count);
+    const auto expected =
+        Benchmark(params, base_requests, queries, "floyd_warshall");
+    const auto actual = Benchmark(params, base_requests, queries, "raptor");
+    if (!AreSame(expected, actual)) {
+      cerr << "Routers disagree on " << params.stop_count << " stops" << endl;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+using Options = unordered_map<string, string>;
+
+Options ParseOptions(int argc, const char* argv[]) {
+  Options options;
+  for (int arg_idx = 2; arg_idx < argc; ++arg_idx) {
+    const string_view arg = argv[arg_idx];
+    const size_t eq_pos = arg.find('=');
+    if (eq_pos == string_view::npos) {
+      throw invalid_argument("expected key=value, got " + string(arg));
+    }
+    options[string(arg.substr(0, eq_pos))] = arg.substr(eq_pos + 1);
+  }
+  return options;
+}
+
+template <typename Number>
+Number GetOption(const Options& options, const string& key, Number value) {
+  if (auto it = options.find(key); it != options.end()) {
+    istringstream(it->second) >> value;
+  }
+  return value;
+}
+
+string GenerateInputText(const Options& options) {
+  const Bench::NetworkParams params = {
+      .stop_count = GetOption<size_t>(options, "stops", 1000),
+      .bus_count = GetOption<size_t>(options, "buses", 200),
+      .stops_per_bus = GetOption<size_t>(options, "stops_per_bus", 30),
+      .roundtrip_ratio = GetOption(options, "roundtrip_ratio", 0.5),
+      .road_distance_density = GetOption(options, "road_density", 0.0),
+      .seed = GetOption<uint32_t>(options, "seed", 42),
+  };
+  const auto router = options.count("router") > 0
+                          ? options.at("router")
+                          : string("blocked_floyd_warshall");
+
+  ostringstream output;
+  Json::PrintValue(
+      Bench::GenerateInput(params, Bench::MakeRoutingSettings(router),
+                           GetOption<size_t>(options, "requests", 10'000)),
+      output);
+  return output.str();
+}
+
+// compare: RAPTOR against Floyd-Warshall on a few networks (the default)
+// generate [key=value...]: prints an input for transport_e
+// phases [key=value...]: times phases of transport_e on a generated input,
+//   or on the one from file=...
+// Keys: stops, buses, stops_per_bus, roundtrip_ratio, road_density, seed,
+// router, requests, threads
+int main(int argc, const char* argv[]) {
+  const string_view mode = argc > 1 ? argv[1] : "compare";
+  const Options options = ParseOptions(argc, argv);
+
+  if (mode == "compare") {
+    return CompareRouters();
+  } else if (mode == "generate") {
+    cout << GenerateInputText(options) << endl;
+  } else if (mode == "phases") {
+    string input;
+    if (options.count("file") > 0) {
+      ifstream input_file(options.at("file"));
+      input.assign(istreambuf_iterator<char>(input_file), {});
+    } else {
+      input = GenerateInputText(options);
+    }
+    ostringstream responses;
+    const auto phases = Bench::RunPhases(
+        input, GetOption<size_t>(options, "threads", 1), responses);
+    Bench::PrintPhases(phases, cout);
+  } else {
+    cerr << "Unknown mode " << mode << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,253 @@
+#include "network_generator.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <random>
+#include <utility>
+
+using namespace std;
+
+namespace Bench {
+
+const double MIN_LATITUDE = 55.55;
+const double MAX_LATITUDE = 55.95;
+const double MIN_LONGITUDE = 37.35;
+const double MAX_LONGITUDE = 37.85;
+const size_t NEIGHBOUR_COUNT = 6;
+
+string GetStopName(size_t stop_idx) {
+  return "Stop " + to_string(stop_idx);
+}
+
+string GetBusName(size_t bus_idx) {
+  return "Bus " + to_string(bus_idx);
+}
+
+// Points are put into a square grid with a few of them per cell, and
+// neighbours are looked for in growing rings of cells around a point
+class NearestStopsFinder {
+ public:
+  explicit NearestStopsFinder(const vector<Sphere::Point>& points)
+      : points_(points),
+        side_(max<size_t>(sqrt(points.size() / 4.0), 1)),
+        cells_(side_ * side_) {
+    for (size_t stop_idx = 0; stop_idx < points.size(); ++stop_idx) {
+      const auto [row, column] = GetCell(points[stop_idx]);
+      cells_[row * side_ + column].push_back(stop_idx);
+    }
+  }
+
+  vector<size_t> Find(size_t stop_idx) const {
+    vector<pair<double, size_t>> candidates;
+    // Closer points may lie in the ring after the one where enough of them
+    // were found, so that ring is looked through as well
+    bool is_enough = false;
+    for (size_t radius = 0; radius < side_; ++radius) {
+      AddRingCandidates(stop_idx, radius, candidates);
+      if (is_enough) {
+        break;
+      }
+      is_enough = candidates.size() >= NEIGHBOUR_COUNT;
+    }
+
+    const size_t count = min(NEIGHBOUR_COUNT, candidates.size());
+    partial_sort(begin(candidates), begin(candidates) + count, end(candidates));
+    vector<size_t> result;
+    for (size_t idx = 0; idx < count; ++idx) {
+      result.push_back(candidates[idx].second);
+    }
+    return result;
+  }
+
+ private:
+  static size_t Diff(size_t lhs, size_t rhs) {
+    return lhs > rhs ? lhs - rhs : rhs - lhs;
+  }
+
+  void AddRingCandidates(size_t stop_idx,
+                         size_t radius,
+                         vector<pair<double, size_t>>& candidates) const {
+    const auto [row, column] = GetCell(points_[stop_idx]);
+    for (size_t cell_row = row >= radius ? row - radius : 0;
+         cell_row <= min(row + radius, side_ - 1); ++cell_row) {
+      for (size_t cell_column = column >= radius ? column - radius : 0;
+           cell_column <= min(column + radius, side_ - 1); ++cell_column) {
+        if (max(Diff(cell_row, row), Diff(cell_column, column)) != radius) {
+          continue;
+        }
+        for (const size_t other_idx : cells_[cell_row * side_ + cell_column]) {
+          if (other_idx != stop_idx) {
+            candidates.emplace_back(
+                Sphere::Distance(points_[stop_idx], points_[other_idx]),
+                other_idx);
+          }
+        }
+      }
+    }
+  }
+
+  pair<size_t, size_t> GetCell(Sphere::Point point) const {
+    auto to_cell = [this](double value, double min_value, double max_value) {
+      const auto cell = static_cast<size_t>((value - min_value) /
+                                            (max_value - min_value) * side_);
+      return min(cell, side_ - 1);
+    };
+    return {to_cell(point.latitude, MIN_LATITUDE, MAX_LATITUDE),
+            to_cell(point.longitude, MIN_LONGITUDE, MAX_LONGITUDE)};
+  }
+
+  const vector<Sphere::Point>& points_;
+  size_t side_;
+  vector<vector<size_t>> cells_;
+};
+
+Json::Array GenerateBaseRequests(const NetworkParams& params) {
+  mt19937 generator(params.seed);
+  uniform_real_distribution<double> latitudes(MIN_LATITUDE, MAX_LATITUDE);
+  uniform_real_distribution<double> longitudes(MIN_LONGITUDE, MAX_LONGITUDE);
+  uniform_real_distribution<double> road_factors(1.0, 1.5);
+  bernoulli_distribution is_roundtrip_bus(params.roundtrip_ratio);
+  bernoulli_distribution has_extra_road(params.road_distance_density);
+
+  vector<Sphere::Point> points(params.stop_count);
+  for (auto& point : points) {
+    point = {latitudes(generator), longitudes(generator)};
+  }
+  const NearestStopsFinder finder(points);
+  vector<vector<size_t>> nearest_stops(params.stop_count);
+  for (size_t stop_idx = 0; stop_idx < params.stop_count; ++stop_idx) {
+    nearest_stops[stop_idx] = finder.Find(stop_idx);
+  }
+
+  map<pair<size_t, size_t>, int> road_distances;
+  auto add_road = [&](size_t from, size_t to) {
+    if (road_distances.count({from, to}) > 0) {
+      return;
+    }
+    const int distance = max(
+        static_cast<int>(Sphere::Distance(points[from], points[to]) *
+                         road_factors(generator)),
+        1);
+    // Both ways, as other buses may go back along the same road
+    road_distances[{from, to}] = distance;
+    road_distances[{to, from}] = distance;
+  };
+
+  Json::Array result;
+  for (size_t bus_idx = 0; bus_idx < params.bus_count; ++bus_idx) {
+    uniform_int_distribution<size_t> stops(0, params.stop_count - 1);
+    vector<size_t> route{stops(generator)};
+    while (route.size() < params.stops_per_bus) {
+      // Going straight back is allowed only from a dead end
+      vector<size_t> neighbours = nearest_stops[route.back()];
+      if (route.size() > 1 && neighbours.size() > 1) {
+        neighbours.erase(
+            remove(begin(neighbours), end(neighbours), route[route.size() - 2]),
+            end(neighbours));
+      }
+      if (neighbours.empty()) {
+        break;
+      }
+      uniform_int_distribution<size_t> neighbour_idx(0, neighbours.size() - 1);
+      route.push_back(neighbours[neighbour_idx(generator)]);
+    }
+
+    const bool is_roundtrip = is_roundtrip_bus(generator) && route.size() > 1;
+    if (is_roundtrip) {
+      route.push_back(route.front());
+    }
+    Json::Array stop_names;
+    for (size_t idx = 0; idx < route.size(); ++idx) {
+      stop_names.push_back(GetStopName(route[idx]));
+      if (idx > 0) {
+        add_road(route[idx - 1], route[idx]);
+      }
+    }
+
+    result.push_back(Json::Dict{
+        {"type", "Bus"s},
+        {"name", GetBusName(bus_idx)},
+        {"stops", move(stop_names)},
+        {"is_roundtrip", is_roundtrip},
+    });
+  }
+
+  for (size_t stop_idx = 0; stop_idx < params.stop_count; ++stop_idx) {
+    for (const size_t neighbour_idx : nearest_stops[stop_idx]) {
+      if (has_extra_road(generator)) {
+        add_road(stop_idx, neighbour_idx);
+      }
+    }
+  }
+
+  for (size_t stop_idx = 0; stop_idx < params.stop_count; ++stop_idx) {
+    Json::Dict distances;
+    for (auto it = road_distances.lower_bound({stop_idx, 0});
+         it != road_distances.end() && it->first.first == stop_idx; ++it) {
+      distances.emplace(Json::Dict::key_type(GetStopName(it->first.second)),
+                        it->second);
+    }
+    result.push_back(Json::Dict{
+        {"type", "Stop"s},
+        {"name", GetStopName(stop_idx)},
+        {"latitude", points[stop_idx].latitude},
+        {"longitude", points[stop_idx].longitude},
+        {"road_distances", move(distances)},
+    });
+  }
+
+  return result;
+}
+
+Json::Array GenerateStatRequests(const NetworkParams& params,
+                                 size_t request_count) {
+  mt19937 generator(params.seed + 1);
+  uniform_int_distribution<size_t> stops(0, params.stop_count - 1);
+  uniform_int_distribution<size_t> buses(0, params.bus_count - 1);
+
+  Json::Array result;
+  result.reserve(request_count);
+  for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
+    const int id = request_idx + 1;
+    switch (request_idx % 4) {
+      case 0:
+        result.push_back(Json::Dict{{"type", "Bus"s},
+                                    {"name", GetBusName(buses(generator))},
+                                    {"id", id}});
+        break;
+      case 1:
+        result.push_back(Json::Dict{{"type", "Stop"s},
+                                    {"name", GetStopName(stops(generator))},
+                                    {"id", id}});
+        break;
+      default:
+        result.push_back(Json::Dict{{"type", "Route"s},
+                                    {"from", GetStopName(stops(generator))},
+                                    {"to", GetStopName(stops(generator))},
+                                    {"id", id}});
+    }
+  }
+  return result;
+}
+
+Json::Dict GenerateInput(const NetworkParams& params,
+                         const Json::Dict& routing_settings,
+                         size_t request_count) {
+  return {
+      {"base_requests", GenerateBaseRequests(params)},
+      {"routing_settings", routing_settings},
+      {"stat_requests", GenerateStatRequests(params, request_count)},
+  };
+}
+
+Json::Dict MakeRoutingSettings(const string& router) {
+  return {
+      {"bus_wait_time", 6},
+      {"bus_velocity", 40},
+      {"router", router},
+  };
+}
+
+}  // namespace Bench
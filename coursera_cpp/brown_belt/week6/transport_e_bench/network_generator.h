@@ -0,0 +1,42 @@
+#pragma once
+
+#include "json.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+struct NetworkParams {
+  size_t stop_count;
+  size_t bus_count;
+  size_t stops_per_bus;  // before a non-roundtrip bus is turned back
+  double roundtrip_ratio = 0.5;
+  // Share of pairs of nearby stops with a road distance given even if no
+  // bus goes between them
+  double road_distance_density = 0.0;
+  uint32_t seed = 42;
+};
+
+// Stops are scattered over a city-sized square. Buses walk between nearby
+// stops, and road distances are geodesic ones stretched by up to a half.
+// The same params always give the same network.
+Json::Array GenerateBaseRequests(const NetworkParams& params);
+
+// Bus, Stop and Route requests in proportion 1:1:2 about random objects
+Json::Array GenerateStatRequests(const NetworkParams& params,
+                                 size_t request_count);
+
+// A whole input as main reads it
+Json::Dict GenerateInput(const NetworkParams& params,
+                         const Json::Dict& routing_settings,
+                         size_t request_count);
+
+// Names of stops and buses as GenerateBaseRequests gives them
+std::string GetStopName(size_t stop_idx);
+std::string GetBusName(size_t bus_idx);
+
+Json::Dict MakeRoutingSettings(const std::string& router);
+
+}  // namespace Bench
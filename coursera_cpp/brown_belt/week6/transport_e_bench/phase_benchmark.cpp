@@ -0,0 +1,80 @@
+#include "phase_benchmark.h"
+#include "descriptions.h"
+#include "json.h"
+#include "requests.h"
+#include "transport_catalog.h"
+#include "transport_router.h"
+
+#include <chrono>
+#include <iomanip>
+#include <memory>
+#include <optional>
+
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace Bench {
+
+size_t GetPeakRssKb() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;  // kilobytes on Linux
+}
+
+vector<PhaseResult> RunPhases(const string& input,
+                              size_t thread_count,
+                              ostream& responses_output) {
+  vector<PhaseResult> phases;
+  auto run_phase = [&phases](string name, auto action) {
+    const auto start = chrono::steady_clock::now();
+    action();
+    const chrono::duration<double, milli> duration =
+        chrono::steady_clock::now() - start;
+    phases.push_back({move(name), duration.count(), GetPeakRssKb()});
+  };
+
+  optional<Json::Document> document;
+  run_phase("json_load", [&] { document = Json::Load(input); });
+  const auto& input_map = document->GetRoot().AsMap();
+
+  optional<Descriptions::Input> descriptions;
+  run_phase("read_descriptions", [&] {
+    descriptions = Descriptions::ReadDescriptions(
+        input_map.at("base_requests").AsArray());
+  });
+
+  unique_ptr<TransportRouter> router;
+  run_phase("router_build", [&] {
+    router = make_unique<TransportRouter>(
+        descriptions->stops, descriptions->buses,
+        descriptions->road_distances,
+        input_map.at("routing_settings").AsMap(), thread_count);
+  });
+
+  optional<TransportCatalog> db;
+  run_phase("catalog_build", [&] {
+    db.emplace(move(*descriptions), move(router), thread_count);
+  });
+
+  run_phase("stat_requests", [&] {
+    Requests::ProcessAll(*db, input_map.at("stat_requests").AsArray(),
+                         responses_output, thread_count);
+  });
+
+  return phases;
+}
+
+void PrintPhases(const vector<PhaseResult>& phases, ostream& output) {
+  output << left << setw(20) << "phase" << right << setw(12) << "ms"
+         << setw(16) << "peak rss, MB" << '\n';
+  output << fixed << setprecision(1);
+  for (const auto& phase : phases) {
+    output << left << setw(20) << phase.name << right << setw(12)
+           << phase.duration_ms << setw(16) << phase.peak_rss_kb / 1024.0
+           << '\n';
+  }
+  output.flush();
+}
+
+}  // namespace Bench
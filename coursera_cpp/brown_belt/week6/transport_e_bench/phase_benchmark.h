@@ -0,0 +1,26 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Bench {
+
+struct PhaseResult {
+  std::string name;
+  double duration_ms;
+  size_t peak_rss_kb;  // of the whole process by the end of the phase
+};
+
+// Goes through the same steps as main on the input text, timing each
+// of them: JSON parsing, reading descriptions, building the router,
+// building the rest of the catalog and answering stat requests
+std::vector<PhaseResult> RunPhases(const std::string& input,
+                                   size_t thread_count,
+                                   std::ostream& responses_output);
+
+size_t GetPeakRssKb();
+
+void PrintPhases(const std::vector<PhaseResult>& phases, std::ostream& output);
+
+}  // namespace Bench
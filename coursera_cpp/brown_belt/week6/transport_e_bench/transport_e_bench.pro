@@ -0,0 +1,32 @@
+TEMPLATE = app
+CONFIG += console c++1z
+CONFIG -= app_bundle
+CONFIG -= qt
+
+TRANSPORT_E_DIR = $$PWD/../transport_e
+
+SOURCES += \
+    main.cpp \
+    network_generator.cpp \
+    phase_benchmark.cpp \
+    $$TRANSPORT_E_DIR/descriptions.cpp \
+    $$TRANSPORT_E_DIR/json.cpp \
+    $$TRANSPORT_E_DIR/profiler.cpp \
+    $$TRANSPORT_E_DIR/raptor_router.cpp \
+    $$TRANSPORT_E_DIR/requests.cpp \
+    $$TRANSPORT_E_DIR/route_cache.cpp \
+    $$TRANSPORT_E_DIR/serialization.cpp \
+    $$TRANSPORT_E_DIR/sphere.cpp \
+    $$TRANSPORT_E_DIR/stop_index.cpp \
+    $$TRANSPORT_E_DIR/transport_catalog.cpp \
+    $$TRANSPORT_E_DIR/transport_router.cpp \
+    $$TRANSPORT_E_DIR/utils.cpp
+
+HEADERS += \
+    network_generator.h \
+    phase_benchmark.h
+
+unix:!macx: LIBS += -L$$OUT_PWD/../../brown_belt_lib/ -lbrown_belt_lib
+
+INCLUDEPATH += $$TRANSPORT_E_DIR $$PWD/../../brown_belt_lib
+DEPENDPATH += $$TRANSPORT_E_DIR $$PWD/../../brown_belt_lib
@@ -5,4 +5,5 @@ SUBDIRS += \
     transport_b \
     transport_c \
     transport_d \
-    transport_e
+    transport_e \
+    transport_e_bench